@@ -0,0 +1,180 @@
+#ifndef ADJACENCY_HPP
+#define ADJACENCY_HPP
+
+#include <limits>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include "parallel.hpp"
+#include "tiling.hpp"
+
+// The segments each segment meets, in a compressed (CSR) layout: the ids of
+// the segments meeting segment i, in increasing order and each once, are
+// neighbors[offsets[i] .. offsets[i + 1]). A pair of segments is in both
+// of their lists, so there are 2 k neighbors for k pairs. The ids are
+// Index and the offsets Offset, both 4 bytes by default: 2 k Index and
+// n + 1 Offset in all.
+template <class Index = uint32_t, class Offset = uint32_t>
+struct Adjacency
+{
+    std::vector<Offset> offsets;
+    std::vector<Index> neighbors;
+
+    size_t degree(size_t id) const
+    {
+        return offsets[id + 1] - offsets[id];
+    }
+
+    // [first, last) of the neighbors of segment id
+    std::pair<const Index *, const Index *> neighbors_of(size_t id) const
+    {
+        return {neighbors.data() + offsets[id], neighbors.data() + offsets[id + 1]};
+    }
+};
+
+// The adjacency of num_segments segments from buffers of pairs (i, j),
+// released once read, by a counting sort straight from the buffers. The
+// segments are split in a range per thread, each thread reads all the
+// buffers and only counts, then places, the entries of its own range, so
+// that no two threads write to the same counter. The offsets are counted
+// one place ahead and serve as the cursors of the placing, which leaves
+// them where they belong; then the lists are sorted and the pairs found
+// more than once, e.g. overlapping segments meeting at both ends, are
+// dropped by moving the lists down. The peak is the buffers with the
+// neighbors, 4 k Index, and the offsets.
+template <class Index, class Offset = uint32_t>
+Adjacency<Index, Offset> adjacency(size_t num_segments, std::vector<std::vector<std::pair<Index, Index>>> &buffers)
+{
+    if (num_segments > size_t(std::numeric_limits<Index>::max()))
+    {
+        throw std::invalid_argument("too many segments for the index type");
+    }
+    size_t num_entries = 0;
+    for (const auto &buffer : buffers)
+    {
+        num_entries += 2 * buffer.size();
+    }
+    if (num_entries > size_t(std::numeric_limits<Offset>::max()))
+    {
+        throw std::invalid_argument("too many pairs for the offset type");
+    }
+    auto adjacency = Adjacency<Index, Offset>();
+    auto &offsets = adjacency.offsets;
+    auto &neighbors = adjacency.neighbors;
+
+    auto num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    auto num_ranges = std::max<size_t>(1, std::min(num_threads, num_segments / 1024));
+    auto range_size = (num_segments + num_ranges - 1) / num_ranges;
+
+    // calls f(i, j) for the entries of the lists of range r
+    auto for_each_entry = [&](size_t r, auto &&f) {
+        auto first = r * range_size, last = std::min(num_segments, first + range_size);
+        for (const auto &buffer : buffers)
+        {
+            for (const auto &pair : buffer)
+            {
+                if (pair.first >= first && pair.first < last)
+                {
+                    f(pair.first, pair.second);
+                }
+                if (pair.second >= first && pair.second < last)
+                {
+                    f(pair.second, pair.first);
+                }
+            }
+        }
+    };
+    auto for_each_range = [&](auto &&f) {
+        parallel_for(
+            num_ranges,
+            [&](size_t first, size_t last) {
+                for (auto r = first; r < last; ++r)
+                {
+                    for_each_entry(r, f);
+                }
+            },
+            1);
+    };
+
+    // the degree of i at i + 2, its start at i + 1 by the sums, its end
+    // there once its entries are placed
+    offsets.assign(num_segments + 2, 0);
+    for_each_range([&offsets](size_t i, Index) { ++offsets[i + 2]; });
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        offsets[i + 2] += offsets[i + 1];
+    }
+    neighbors.resize(num_entries);
+    for_each_range([&](size_t i, Index j) { neighbors[offsets[i + 1]++] = j; });
+    buffers = {};
+    offsets.pop_back();
+
+    parallel_for(num_segments, [&](size_t first, size_t last) {
+        for (auto i = first; i < last; ++i)
+        {
+            std::sort(neighbors.begin() + offsets[i], neighbors.begin() + offsets[i + 1]);
+        }
+    });
+
+    // the repeated pairs are dropped by moving the lists down, never past
+    // an entry still to be read
+    size_t size = 0;
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        auto begin = offsets[i], end = offsets[i + 1];
+        offsets[i] = size;
+        for (auto k = begin; k < end; ++k)
+        {
+            if (k == begin || neighbors[k] != neighbors[k - 1])
+            {
+                neighbors[size++] = neighbors[k];
+            }
+        }
+    }
+    offsets[num_segments] = size;
+    if (size != neighbors.size())
+    {
+        neighbors.resize(size);
+        neighbors.shrink_to_fit();
+    }
+    return adjacency;
+}
+
+// The adjacency of the segments, swept over a grid of tiles a row at a
+// time as tiled_intersections does, the tiles of a row concurrently; the
+// sweep of each tile appends its pairs to a buffer of its own. With the
+// default 1 x 1 grid there is one sweep and one buffer, on one thread;
+// only the building of the lists is spread over the threads then.
+template <class Index = uint32_t, class Offset = uint32_t, class Segments>
+Adjacency<Index, Offset> adjacency(const Segments &segments, size_t columns = 1, size_t rows = 1)
+{
+    using Kernel = typename SegmentTraits<Segments>::Kernel;
+
+    auto grid = tile_grid(segments, columns, rows);
+    auto buffers = std::vector<std::vector<std::pair<Index, Index>>>(grid.size());
+    for (size_t row = 0; row < grid.rows; ++row)
+    {
+        auto tiles = row_segments(segments, grid, row);
+        parallel_for(
+            grid.columns,
+            [&](size_t first, size_t last) {
+                for (auto column = first; column < last; ++column)
+                {
+                    auto t = row * grid.columns + column;
+                    sweep_tile(segments, grid, t, tiles[column],
+                               [&buffer = buffers[t]](const IntersectionRecord<Kernel> &record) {
+                                   buffer.push_back({Index(record.i), Index(record.j)});
+                               });
+                    tiles[column] = {};
+                }
+            },
+            1);
+    }
+    return adjacency<Index, Offset>(SegmentTraits<Segments>::size(segments), buffers);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef BOOLEAN_HPP
+#define BOOLEAN_HPP
+
+#include <vector>
+#include <iterator>
+
+#include "sweep_line.hpp"
+#include "dcel.hpp"
+
+// Boolean operations on two polygon layers in the manner of Martinez and
+// Rueda, in a single sweep. A layer is a set of rings under the even-odd
+// rule, so a multi-polygon with holes is just all of its rings. Every
+// segment on the sweep line carries the layers covering the region to its
+// right: going left to right at an event point, the region right of a
+// piece is the one right of its left neighbour with the piece's own layer
+// toggled, overlapping pieces counting once with all of their layers. A
+// piece belongs to the result when the operation's result differs on its
+// two sides; only those pieces enter the arrangement, and its cycles with
+// the result on their left are the output rings.
+
+enum class BooleanOperation
+{
+    union_,
+    intersection,
+    difference,
+    symmetric_difference,
+};
+
+// Rings of the result, with the result on their left: outer boundaries are
+// counterclockwise and holes clockwise.
+template <class Kernel>
+std::vector<std::vector<typename Kernel::EventPoint>> boolean_operation(const std::vector<Ring<Kernel>> &subject,
+                                                                      const std::vector<Ring<Kernel>> &clip,
+                                                                      BooleanOperation operation)
+{
+    enum : unsigned char
+    {
+        in_subject = 1,
+        in_clip = 2,
+    };
+
+    // the edges of the subject come first
+    auto segments = std::vector<Segment<Kernel>>();
+    auto add_rings = [&segments](const std::vector<Ring<Kernel>> &rings) {
+        for (const auto &ring : rings)
+        {
+            for (size_t i = 0; i < ring.size(); ++i)
+            {
+                segments.push_back({ring[i], ring[(i + 1) % ring.size()]});
+            }
+        }
+    };
+    add_rings(subject);
+    auto num_subject = segments.size();
+    add_rings(clip);
+
+    auto inside = [operation](unsigned char layers) {
+        switch (operation)
+        {
+        case BooleanOperation::union_:
+            return layers != 0;
+        case BooleanOperation::intersection:
+            return layers == (in_subject | in_clip);
+        case BooleanOperation::difference:
+            return layers == in_subject;
+        default:
+            return layers == in_subject || layers == in_clip;
+        }
+    };
+
+    // the layers right of each segment on the sweep line
+    auto right_of = std::vector<unsigned char>(segments.size(), 0);
+    // whether the result is left of each half-edge
+    auto interior = std::vector<bool>();
+
+    // overlapping pieces below a point are adjacent on the sweep line, they
+    // are taken as one so that no zero width sliver enters the result
+    auto overlap = [&segments](size_t id1, size_t id2) {
+        const auto &s1 = segments[id1], &s2 = segments[id2];
+        return Kernel::orientation(s1.a, s1.b, s2.a) == 0 && Kernel::orientation(s1.a, s1.b, s2.b) == 0;
+    };
+    auto layer = [num_subject](size_t id) {
+        return id < num_subject ? in_subject : in_clip;
+    };
+
+    auto dcel = build_dcel_if(segments, [&](const auto &status, auto it, size_t h) {
+        if (it != status.begin() && overlap(std::prev(it)->id, it->id))
+        {
+            right_of[it->id] = right_of[std::prev(it)->id];
+            return false;
+        }
+        auto left = it == status.begin() ? 0 : right_of[std::prev(it)->id];
+        auto right = left ^ layer(it->id);
+        for (auto next = std::next(it); next != status.end() && overlap(it->id, next->id); ++next)
+        {
+            right ^= layer(next->id);
+        }
+        right_of[it->id] = right;
+        if (inside(left) == inside(right))
+        {
+            return false;
+        }
+        // h goes down, its left is the right of the sweep line
+        interior.resize(h + 2);
+        interior[h] = inside(right);
+        interior[h + 1] = inside(left);
+        return true;
+    });
+
+    auto rings = std::vector<std::vector<typename Kernel::EventPoint>>();
+    auto visited = std::vector<bool>(dcel.half_edges.size(), false);
+    for (size_t h = 0; h < dcel.half_edges.size(); ++h)
+    {
+        if (!interior[h] || visited[h])
+        {
+            continue;
+        }
+        auto ring = std::vector<typename Kernel::EventPoint>();
+        for (auto e = h; !visited[e]; e = dcel.half_edges[e].next)
+        {
+            visited[e] = true;
+            ring.push_back(dcel.vertices[dcel.half_edges[e].origin].point);
+        }
+        rings.push_back(std::move(ring));
+    }
+    return rings;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef COVERAGE_HPP
+#define COVERAGE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+
+// Union area and perimeter of axis parallel rectangles (Klee's measure in
+// the plane) by a sweep from top to bottom over their horizontal edges. A
+// segment tree over the compressed x coordinates keeps the length covered
+// on the sweep line and the number of separate pieces it is made of, so
+// the whole sweep is O(n log n).
+
+// integer areas could overflow the coordinate type
+template <class T>
+using Area = std::conditional_t<std::is_integral<T>::value, __int128, T>;
+
+template <class T>
+struct Coverage
+{
+    Area<T> area;
+    T perimeter;
+};
+
+// covered length of the x axis, updated by ranges of elementary intervals
+template <class T>
+class CoverTree
+{
+  public:
+    explicit CoverTree(std::vector<T> xs) : xs(std::move(xs))
+    {
+        size_t leaves = 1;
+        while (leaves < this->xs.size())
+        {
+            leaves *= 2;
+        }
+        nodes.resize(2 * leaves);
+    }
+
+    // add delta to the cover count of [xs[lo], xs[hi])
+    void add(size_t lo, size_t hi, int delta)
+    {
+        if (lo < hi)
+        {
+            add(1, 0, xs.size() - 1, lo, hi, delta);
+        }
+    }
+
+    T length() const
+    {
+        return nodes[1].length;
+    }
+
+    size_t pieces() const
+    {
+        return nodes[1].pieces();
+    }
+
+  private:
+    // 16 bytes, the bottom levels are where the sweep misses the cache
+    struct Node
+    {
+        T length = 0;
+        int32_t count = 0; // rectangles covering the whole node, not its parent
+        uint32_t ends = 0; // number of pieces, then covered at the left and right end
+
+        static constexpr uint32_t left = 1u << 31, right = 1u << 30;
+
+        uint32_t pieces() const
+        {
+            return ends & ~(left | right);
+        }
+    };
+
+    void add(size_t node, size_t l, size_t r, size_t lo, size_t hi, int delta)
+    {
+        if (lo <= l && r <= hi)
+        {
+            nodes[node].count += delta;
+        }
+        else
+        {
+            auto m = (l + r) / 2;
+            if (lo < m)
+            {
+                add(2 * node, l, m, lo, hi, delta);
+            }
+            if (m < hi)
+            {
+                add(2 * node + 1, m, r, lo, hi, delta);
+            }
+        }
+        pull(node, l, r);
+    }
+
+    void pull(size_t node, size_t l, size_t r)
+    {
+        auto &n = nodes[node];
+        if (n.count > 0)
+        {
+            n.length = xs[r] - xs[l];
+            n.ends = 1 | Node::left | Node::right;
+        }
+        else if (r - l == 1)
+        {
+            n.length = 0;
+            n.ends = 0;
+        }
+        else
+        {
+            const auto &a = nodes[2 * node], &b = nodes[2 * node + 1];
+            auto joined = (a.ends & Node::right) && (b.ends & Node::left);
+            n.length = a.length + b.length;
+            n.ends = (a.pieces() + b.pieces() - joined) | (a.ends & Node::left) | (b.ends & Node::right);
+        }
+    }
+
+    std::vector<T> xs;
+    std::vector<Node> nodes;
+};
+
+// The rectangles are read once from an input range of boxes with xlo, ylo,
+// xhi and yhi (e.g. Box), only their edges are kept. Empty ones are skipped.
+template <class Iterator>
+auto union_measure(Iterator first, Iterator last)
+{
+    using T = std::decay_t<decltype(first->xlo)>;
+
+    // x ranks instead of coordinates once xs is known
+    struct Edge
+    {
+        T y;
+        uint32_t lo, hi;
+        int delta;
+    };
+
+    auto edges = std::vector<Edge>();
+    auto xs = std::vector<T>();
+    for (; first != last; ++first)
+    {
+        const auto &box = *first;
+        if (box.xlo < box.xhi && box.ylo < box.yhi)
+        {
+            edges.push_back({box.yhi, 0, 0, 1});
+            edges.push_back({box.ylo, 0, 0, -1});
+            xs.push_back(box.xlo);
+            xs.push_back(box.xhi);
+        }
+    }
+    // xs[2 k] and xs[2 k + 1] are the left and right ends of the edges 2 k
+    // and 2 k + 1, give those their ranks while dropping duplicates
+    auto order = std::vector<uint32_t>(xs.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&xs](uint32_t i, uint32_t j) { return xs[i] < xs[j]; });
+    auto sorted = std::vector<T>();
+    sorted.reserve(xs.size());
+    for (auto i : order)
+    {
+        if (sorted.empty() || sorted.back() < xs[i])
+        {
+            sorted.push_back(xs[i]);
+        }
+        uint32_t rank = sorted.size() - 1;
+        for (auto e : {i & ~1u, i | 1u})
+        {
+            (i & 1 ? edges[e].hi : edges[e].lo) = rank;
+        }
+    }
+    xs = std::move(sorted);
+    // from the top, rectangles entering at a height come before the leaving
+    // ones so that edges shared by two of them are not counted
+    std::sort(edges.begin(), edges.end(), [](const Edge &e1, const Edge &e2) {
+        return e1.y != e2.y ? e1.y > e2.y : e1.delta > e2.delta;
+    });
+
+    auto tree = CoverTree<T>(xs);
+    auto coverage = Coverage<T>{0, 0};
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        const auto &edge = edges[i];
+        if (i > 0)
+        {
+            auto dy = edges[i - 1].y - edge.y;
+            coverage.area += Area<T>(tree.length()) * dy;
+            coverage.perimeter += 2 * T(tree.pieces()) * dy;
+        }
+        auto before = tree.length();
+        tree.add(edge.lo, edge.hi, edge.delta);
+        auto after = tree.length();
+        coverage.perimeter += after > before ? after - before : before - after;
+    }
+    return coverage;
+}
+
+#endif
@@ -0,0 +1,379 @@
+#ifndef DCEL_HPP
+#define DCEL_HPP
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include "sweep_line.hpp"
+#include "noding.hpp"
+
+// Doubly-connected edge list of the arrangement of the segments. Vertices
+// and half-edges live in pools and link to each other by index, vertices
+// in sweep order. Overlapping segments give parallel edges between the
+// same vertices.
+template <class Kernel>
+struct Dcel
+{
+    using EventPoint = typename Kernel::EventPoint;
+
+    static constexpr size_t none = size_t(-1);
+
+    struct Vertex
+    {
+        EventPoint point;
+        size_t edge; // one outgoing half-edge
+    };
+
+    // the face of a half-edge is on its left, face 0 is the unbounded one
+    struct HalfEdge
+    {
+        size_t origin;
+        size_t twin, next, prev;
+        size_t face;
+        size_t segment;
+        bool forward; // runs from a towards b of its segment
+    };
+
+    std::vector<Vertex> vertices;
+    std::vector<HalfEdge> half_edges;
+    size_t num_faces = 0;
+
+    size_t add_vertex(const EventPoint &point)
+    {
+        vertices.push_back({point, none});
+        return vertices.size() - 1;
+    }
+
+    // a pair of twins along the segment, the first one leaves origin
+    size_t add_edge(size_t origin, size_t segment, bool forward)
+    {
+        auto h = half_edges.size();
+        half_edges.push_back({origin, h + 1, none, none, none, segment, forward});
+        half_edges.push_back({none, h, none, none, none, segment, !forward});
+        return h;
+    }
+
+    size_t destination(size_t h) const
+    {
+        return half_edges[half_edges[h].twin].origin;
+    }
+
+    // the ends of the segment of h, in the direction of h
+    std::pair<typename Kernel::Point, typename Kernel::Point> ends(size_t h,
+                                                                  const std::vector<Segment<Kernel>> &segments) const
+    {
+        const auto &segment = segments[half_edges[h].segment];
+        return half_edges[h].forward ? std::make_pair(segment.a, segment.b) : std::make_pair(segment.b, segment.a);
+    }
+
+    // Link the half-edges leaving a vertex: sorted counterclockwise, the
+    // twin of each one continues with its clockwise neighbour.
+    void link_around(size_t vertex, std::vector<size_t> &outgoing, const std::vector<Segment<Kernel>> &segments)
+    {
+        if (outgoing.empty())
+        {
+            return;
+        }
+        // counterclockwise from the west: the ones going down, then up
+        std::sort(outgoing.begin(), outgoing.end(), [this, &segments](size_t h1, size_t h2) {
+            auto e1 = ends(h1, segments), e2 = ends(h2, segments);
+            bool down1 = vertically_less(e1.second, e1.first);
+            bool down2 = vertically_less(e2.second, e2.first);
+            if (down1 != down2)
+            {
+                return down1;
+            }
+            return Kernel::orientation(e1.first, e1.second, e2.first, e2.second) > 0;
+        });
+        for (size_t i = 0; i < outgoing.size(); ++i)
+        {
+            auto h = outgoing[i];
+            auto cw = outgoing[(i + outgoing.size() - 1) % outgoing.size()];
+            auto incoming = half_edges[h].twin;
+            half_edges[incoming].next = cw;
+            half_edges[cw].prev = incoming;
+        }
+        vertices[vertex].edge = outgoing.front();
+    }
+
+    // Label the faces. The cycles of next links are found first. A cycle
+    // turning left at every pass through its topmost vertex bounds a face of
+    // its own; the others are holes, the outer boundaries of connected
+    // components, and belong to the face around their topmost vertex.
+    // locate(tops) gives, for these vertices in increasing order, the
+    // half-edge going down directly left of each, none under the unbounded
+    // face. Since that half-edge starts above the hole, its face is known by
+    // the time the hole comes up in sweep order.
+    template <class Locate>
+    void label_faces(const std::vector<Segment<Kernel>> &segments, Locate &&locate)
+    {
+        // the face of a half-edge is its cycle until the end
+        auto cycle = [this](size_t h) -> size_t & {
+            return half_edges[h].face;
+        };
+        auto top = std::vector<size_t>();
+        for (auto &h : half_edges)
+        {
+            h.face = none;
+        }
+        for (size_t h = 0; h < half_edges.size(); ++h)
+        {
+            if (cycle(h) != none)
+            {
+                continue;
+            }
+            top.push_back(half_edges[h].origin);
+            for (auto e = h; cycle(e) == none; e = half_edges[e].next)
+            {
+                cycle(e) = top.size() - 1;
+                top.back() = std::min(top.back(), half_edges[e].origin);
+            }
+        }
+
+        // going down both ways, the turn is to the right or back exactly
+        // when the upward direction is on the left
+        auto hole = std::vector<bool>(top.size(), false);
+        for (size_t e = 0; e < half_edges.size(); ++e)
+        {
+            auto next = half_edges[e].next;
+            if (half_edges[next].origin != top[cycle(e)] || hole[cycle(e)])
+            {
+                continue;
+            }
+            auto in = ends(e, segments), out = ends(next, segments);
+            hole[cycle(e)] = Kernel::orientation(in.first, in.second, out.first, out.second) <= 0;
+        }
+
+        auto order = std::vector<size_t>(top.size()), tops = std::vector<size_t>();
+        for (size_t c = 0; c < top.size(); ++c)
+        {
+            order[c] = c;
+        }
+        std::sort(order.begin(), order.end(), [&top](size_t c1, size_t c2) { return top[c1] < top[c2]; });
+        for (auto c : order)
+        {
+            if (hole[c])
+            {
+                tops.push_back(top[c]);
+            }
+        }
+        auto left = locate(tops);
+
+        auto face = std::vector<size_t>(top.size());
+        num_faces = 1;
+        size_t k = 0;
+        for (auto c : order)
+        {
+            if (!hole[c])
+            {
+                face[c] = num_faces++;
+                continue;
+            }
+            auto h = left[k++];
+            face[c] = h == none ? 0 : face[cycle(h)];
+        }
+        for (size_t h = 0; h < half_edges.size(); ++h)
+        {
+            cycle(h) = face[cycle(h)];
+        }
+    }
+};
+
+// Build the arrangement while sweeping: at every event point the segments
+// through it close the half-edge they opened above and open a new one
+// below, and the point's half-edges are linked right away. The pieces
+// opening below a point are offered left to right to keep(status, it, h),
+// with it the segment in the status and h its half-edge going down; the
+// ones it rejects are left out of the arrangement. At a vertex nothing
+// arrives at, the nearest half-edge going down on its left is at hand in
+// the status, which places the holes in their faces.
+template <class Kernel, class Keep>
+Dcel<Kernel> build_dcel_if(const std::vector<Segment<Kernel>> &segments, Keep &&keep)
+{
+    using Event = ::Event<Kernel>;
+
+    auto dcel = Dcel<Kernel>();
+    dcel.vertices.reserve(segments.size() * 2);
+    dcel.half_edges.reserve(segments.size() * 4);
+
+    // the half-edge each segment on the sweep line leaves downwards
+    auto open = std::vector<size_t>(segments.size(), Dcel<Kernel>::none);
+    auto outgoing = std::vector<size_t>();
+    // (vertex nothing arrives at, half-edge going down left of it)
+    auto left = std::vector<std::pair<size_t, size_t>>();
+
+    sweep_line(segments, [&](const auto &point, const auto &events, const auto &status) {
+        auto vertex = dcel.add_vertex(point);
+        outgoing.clear();
+        auto arrived = false;
+
+        auto arrive = [&](size_t id) {
+            if (open[id] == Dcel<Kernel>::none)
+            {
+                return;
+            }
+            arrived = true;
+            auto incoming = dcel.half_edges[open[id]].twin;
+            dcel.half_edges[incoming].origin = vertex;
+            outgoing.push_back(incoming);
+            open[id] = Dcel<Kernel>::none;
+        };
+
+        for (const auto &event : events)
+        {
+            if (event.type == Event::Type::lower)
+            {
+                arrive(event.segment.id);
+            }
+        }
+        auto through = segments_through(status, point);
+        for (auto it = through.first; it != through.second; ++it)
+        {
+            auto id = it->id;
+            arrive(id);
+            const auto &segment = segments[id];
+            auto h = dcel.add_edge(vertex, id, vertically_less(segment.b, segment.a));
+            if (!keep(status, it, h))
+            {
+                dcel.half_edges.resize(h);
+                continue;
+            }
+            open[id] = h;
+            outgoing.push_back(h);
+        }
+
+        if (outgoing.empty())
+        {
+            dcel.vertices.pop_back();
+            return;
+        }
+        dcel.link_around(vertex, outgoing, segments);
+        if (!arrived)
+        {
+            // the segments left out have no half-edge
+            auto h = Dcel<Kernel>::none;
+            for (auto it = through.first; h == Dcel<Kernel>::none && it != status.begin();)
+            {
+                h = open[(--it)->id];
+            }
+            left.push_back({vertex, h});
+        }
+    });
+
+    dcel.label_faces(segments, [&left](const std::vector<size_t> &tops) {
+        auto found = std::vector<size_t>();
+        auto it = left.begin();
+        for (auto vertex : tops)
+        {
+            it = std::lower_bound(it, left.end(), std::make_pair(vertex, size_t(0)));
+            found.push_back(it->second);
+        }
+        return found;
+    });
+    return dcel;
+}
+
+template <class Kernel>
+Dcel<Kernel> build_dcel(const std::vector<Segment<Kernel>> &segments)
+{
+    return build_dcel_if(segments, [](const auto &, auto, size_t) { return true; });
+}
+
+// Build the arrangement from noded segments in a separate pass: the pieces'
+// endpoints are sorted to merge equal vertices, then linked around each.
+// Placing the holes in their faces takes another sweep, for the segment
+// directly left of the top of each hole.
+template <class Kernel>
+Dcel<Kernel> build_dcel(const std::vector<Segment<Kernel>> &segments, const Noding<Kernel> &noding)
+{
+    auto dcel = Dcel<Kernel>();
+
+    // (point, half-edge leaving it), and the pieces of each segment from a
+    // to b as half-edges first[id], first[id] + 2, ...
+    auto ends = std::vector<std::pair<typename Kernel::EventPoint, size_t>>();
+    auto first = std::vector<size_t>(segments.size() + 1, 0);
+    for (size_t id = 0; id < segments.size(); ++id)
+    {
+        first[id] = dcel.half_edges.size();
+        if (segments[id].a == segments[id].b)
+        {
+            continue;
+        }
+        noding.for_each_sub_segment(segments[id], id, [&](const auto &from, const auto &to) {
+            auto h = dcel.add_edge(Dcel<Kernel>::none, id, true);
+            ends.push_back({from, h});
+            ends.push_back({to, h + 1});
+        });
+    }
+    first.back() = dcel.half_edges.size();
+    // in sweep order
+    std::sort(ends.begin(), ends.end(), [](const auto &e1, const auto &e2) {
+        return Kernel::vertically_less(e2.first, e1.first);
+    });
+
+    auto outgoing = std::vector<size_t>();
+    for (size_t i = 0; i < ends.size();)
+    {
+        auto vertex = dcel.add_vertex(ends[i].first);
+        outgoing.clear();
+        for (; i < ends.size() && Kernel::equal(ends[i].first, dcel.vertices[vertex].point); ++i)
+        {
+            dcel.half_edges[ends[i].second].origin = vertex;
+            outgoing.push_back(ends[i].second);
+        }
+        dcel.link_around(vertex, outgoing, segments);
+    }
+
+    // the half-edge going down along the piece of segment id beside a vertex
+    auto piece_beside = [&](size_t id, size_t vertex) {
+        const auto &segment = segments[id];
+        auto down = vertically_less(segment.b, segment.a);
+        // the pieces from a to b go down the vertices if the segment does,
+        // the first one not above the vertex otherwise
+        size_t low = 0, high = (first[id + 1] - first[id]) / 2;
+        while (low < high)
+        {
+            auto middle = (low + high) / 2;
+            auto h = first[id] + 2 * middle;
+            if (down ? dcel.half_edges[h].origin < vertex : dcel.destination(h) > vertex)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return down ? first[id] + 2 * (low - 1) : first[id] + 2 * low + 1;
+    };
+
+    dcel.label_faces(segments, [&](const std::vector<size_t> &tops) {
+        auto found = std::vector<size_t>(tops.size(), Dcel<Kernel>::none);
+        size_t k = 0;
+        sweep_line(segments, [&](const auto &point, const auto &, const auto &status) {
+            if (k == tops.size() || !Kernel::equal(point, dcel.vertices[tops[k]].point))
+            {
+                return;
+            }
+            // the segments through the point start there, the nearest one
+            // on the left with pieces passes beside it
+            auto it = segments_through(status, point).first;
+            while (it != status.begin())
+            {
+                --it;
+                if (!(it->a == it->b))
+                {
+                    found[k] = piece_beside(it->id, tops[k]);
+                    break;
+                }
+            }
+            ++k;
+        });
+        return found;
+    });
+    return dcel;
+}
+
+#endif
@@ -0,0 +1,627 @@
+#ifndef EXTERNAL_SWEEP_HPP
+#define EXTERNAL_SWEEP_HPP
+
+#include <string>
+#include <vector>
+#include <future>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+#include <type_traits>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sweep_line.hpp"
+
+// Out-of-core sweep for inputs larger than memory. The input is read once,
+// in order, so it should be cheap to read sequentially (e.g. a mapped
+// segment file, see MappedSegmentsView); its endpoint events are sorted in
+// runs that fit the memory budget and written to a temporary file, then
+// merged as the sweep goes. Every event carries its segment, the input is
+// not read again out of order. Runs are written and read sequentially, the
+// next block always in the background while the current one is used.
+//
+// The events found during the sweep are kept within a budget too, they
+// spill to disk when too many are pending, e.g. for an input with very
+// many intersections. Only the status has to fit in memory.
+
+// I/O of the external sweeps run on this thread, one read or write per
+// block; spilled and reloaded are the bytes of events found during the
+// sweep that went to disk and came back
+struct IoStatistics
+{
+    size_t reads = 0, writes = 0;
+    size_t bytes_read = 0, bytes_written = 0;
+    size_t spilled = 0, reloaded = 0;
+};
+
+inline IoStatistics &io_statistics()
+{
+    static thread_local IoStatistics statistics;
+    return statistics;
+}
+
+namespace external
+{
+// An unnamed temporary file, gone once closed. Reads and writes are at
+// given offsets, so they may run on other threads.
+class TemporaryFile
+{
+  public:
+    explicit TemporaryFile(const std::string &directory)
+    {
+        auto path = directory + "/sweep-XXXXXX";
+        fd = ::mkstemp(&path[0]);
+        if (fd < 0)
+        {
+            throw std::runtime_error("cannot create a temporary file in " + directory);
+        }
+        ::unlink(path.c_str());
+    }
+
+    TemporaryFile(const TemporaryFile &) = delete;
+    TemporaryFile &operator=(const TemporaryFile &) = delete;
+
+    ~TemporaryFile()
+    {
+        ::close(fd);
+    }
+
+    void write(const void *data, size_t bytes, size_t offset) const
+    {
+        for (auto p = static_cast<const char *>(data); bytes > 0;)
+        {
+            auto written = ::pwrite(fd, p, bytes, offset);
+            if (written <= 0)
+            {
+                throw std::runtime_error("cannot write a temporary file");
+            }
+            p += written;
+            bytes -= written;
+            offset += written;
+        }
+    }
+
+    void read(void *data, size_t bytes, size_t offset) const
+    {
+        for (auto p = static_cast<char *>(data); bytes > 0;)
+        {
+            auto read = ::pread(fd, p, bytes, offset);
+            if (read <= 0)
+            {
+                throw std::runtime_error("cannot read a temporary file");
+            }
+            p += read;
+            bytes -= read;
+            offset += read;
+        }
+    }
+
+  private:
+    int fd;
+};
+
+// Records [first, last) of a file, the next block read ahead.
+template <class Record>
+class RunReader
+{
+  public:
+    RunReader(const TemporaryFile &file, size_t first, size_t last, size_t block)
+        : file(&file), next(first), last(last), current(block), ahead(block)
+    {
+        fetch();
+        advance();
+    }
+
+    bool empty() const
+    {
+        return position == size;
+    }
+
+    const Record &front() const
+    {
+        return current[position];
+    }
+
+    // records not popped yet
+    size_t remaining() const
+    {
+        return size - position + fetched + (last - next);
+    }
+
+    void pop()
+    {
+        if (++position == size)
+        {
+            advance();
+        }
+    }
+
+  private:
+    void fetch()
+    {
+        fetched = std::min(ahead.size(), last - next);
+        if (fetched == 0)
+        {
+            return;
+        }
+        ++io_statistics().reads;
+        io_statistics().bytes_read += fetched * sizeof(Record);
+        // the buffer stays in place when the reader is moved
+        pending = std::async(std::launch::async, [file = file, data = ahead.data(), count = fetched, at = next]() {
+            file->read(data, count * sizeof(Record), at * sizeof(Record));
+        });
+        next += fetched;
+    }
+
+    void advance()
+    {
+        if (pending.valid())
+        {
+            pending.get();
+        }
+        std::swap(current, ahead);
+        size = fetched;
+        position = 0;
+        if (size == 0)
+        {
+            // done, the buffers are not needed anymore
+            current = {};
+            ahead = {};
+            return;
+        }
+        fetch();
+    }
+
+    const TemporaryFile *file;
+    size_t next, last;
+    std::vector<Record> current, ahead;
+    size_t position = 0, size = 0, fetched = 0;
+    std::future<void> pending; // destroyed first, it waits for the read
+};
+} // namespace external
+
+// The endpoint events for sweep_line from runs on disk, within a memory
+// budget in bytes: two runs while the input is read, one block and one
+// read ahead per run while they are merged. Past max_fan_in runs, they are
+// first merged max_fan_in at a time into longer runs appended to the file,
+// as many passes as it takes, so that the blocks stay large and the reads
+// sequential; each pass writes the input again. Nothing is written when
+// the whole input fits in one run.
+template <class Segments>
+class ExternalEndpoints
+{
+  public:
+    using Traits = SegmentTraits<Segments>;
+    using Kernel = typename Traits::Kernel;
+    using Point = typename Kernel::Point;
+
+    // an endpoint event with its segment
+    struct Record
+    {
+        Point a, b;
+        uint64_t code; // 2 i for the upper endpoint of segment i, 2 i + 1 for the lower one
+        uint64_t next; // see Segment::next
+    };
+    static_assert(std::is_trivially_copyable<Record>::value, "records are written as they are");
+
+    static constexpr size_t max_fan_in = 16;
+
+    ExternalEndpoints(const Segments &segments, size_t memory,
+                      const std::string &directory = std::filesystem::temp_directory_path().string())
+        : file(directory)
+    {
+        auto run_size = std::max<size_t>(1, memory / (2 * sizeof(Record)));
+        auto filling = std::vector<Record>(), writing = std::vector<Record>();
+        filling.reserve(run_size);
+        writing.reserve(run_size);
+        auto written = std::future<void>();
+        auto bounds = std::vector<std::pair<size_t, size_t>>();
+        // the next event first
+        auto sort = [](std::vector<Record> &records) {
+            std::sort(records.begin(), records.end(), [](const Record &r1, const Record &r2) {
+                return vertically_less(endpoint(r2), endpoint(r1));
+            });
+        };
+        auto flush = [&]() {
+            sort(filling);
+            if (written.valid())
+            {
+                written.get();
+            }
+            std::swap(filling, writing);
+            filling.clear();
+            auto first = bounds.empty() ? 0 : bounds.back().second;
+            bounds.push_back({first, first + writing.size()});
+            ++io_statistics().writes;
+            io_statistics().bytes_written += writing.size() * sizeof(Record);
+            written = std::async(std::launch::async, [this, &writing, first]() {
+                file.write(writing.data(), writing.size() * sizeof(Record), first * sizeof(Record));
+            });
+        };
+
+        auto continued = continued_segments(segments);
+        for (size_t i = 0; i < continued.size(); ++i)
+        {
+            if (continued[i])
+            {
+                continue;
+            }
+            for (uint64_t code : {2 * i, 2 * i + 1})
+            {
+                if (filling.size() == run_size)
+                {
+                    flush();
+                }
+                filling.push_back({Traits::a(segments, i), Traits::b(segments, i), code, Traits::next(segments, i)});
+            }
+        }
+        if (bounds.empty())
+        {
+            sort(filling);
+            records = std::move(filling);
+            return;
+        }
+        if (!filling.empty())
+        {
+            flush();
+        }
+        written.get();
+        writing = {};
+        filling = {};
+        while (bounds.size() > max_fan_in)
+        {
+            bounds = merge_runs(bounds, memory);
+        }
+
+        auto block = std::max<size_t>(1, memory / (2 * bounds.size() * sizeof(Record)));
+        readers.reserve(bounds.size());
+        for (const auto &run : bounds)
+        {
+            readers.emplace_back(file, run.first, run.second, block);
+            heap.push_back(readers.size() - 1);
+        }
+        std::make_heap(heap.begin(), heap.end(), later());
+    }
+
+    bool empty() const
+    {
+        return readers.empty() ? position == records.size() : heap.empty();
+    }
+
+    typename Kernel::EventPoint point() const
+    {
+        return Kernel::to_event_point(endpoint(front()));
+    }
+
+    bool upper() const
+    {
+        return front().code % 2 == 0;
+    }
+
+    Segment<Kernel> segment() const
+    {
+        const auto &record = front();
+        auto segment = Segment<Kernel>{record.a, record.b};
+        segment.id = record.code / 2;
+        segment.key = Kernel::to_event_point(segment.upper_endpoint());
+        segment.next = record.next;
+        return segment;
+    }
+
+    void pop()
+    {
+        if (readers.empty())
+        {
+            ++position;
+            return;
+        }
+        std::pop_heap(heap.begin(), heap.end(), later());
+        auto &reader = readers[heap.back()];
+        reader.pop();
+        if (reader.empty())
+        {
+            heap.pop_back();
+        }
+        else
+        {
+            std::push_heap(heap.begin(), heap.end(), later());
+        }
+    }
+
+    // the number of sorted runs written, 0 if everything fit in memory
+    size_t runs() const
+    {
+        return readers.size();
+    }
+
+  private:
+    static Point endpoint(const Record &record)
+    {
+        return vertically_less(record.a, record.b) == (record.code % 2 == 0) ? record.b : record.a;
+    }
+
+    // One pass of the merge: the runs max_fan_in at a time into one each,
+    // appended to the file and written a block at a time.
+    std::vector<std::pair<size_t, size_t>> merge_runs(const std::vector<std::pair<size_t, size_t>> &bounds,
+                                                      size_t memory)
+    {
+        auto block = std::max<size_t>(1, memory / ((2 * max_fan_in + 1) * sizeof(Record)));
+        auto end = bounds.back().second;
+        auto merged = std::vector<std::pair<size_t, size_t>>();
+        auto buffer = std::vector<Record>();
+        buffer.reserve(block);
+        auto flush = [&]() {
+            ++io_statistics().writes;
+            io_statistics().bytes_written += buffer.size() * sizeof(Record);
+            file.write(buffer.data(), buffer.size() * sizeof(Record), end * sizeof(Record));
+            end += buffer.size();
+            buffer.clear();
+        };
+
+        for (size_t first = 0; first < bounds.size(); first += max_fan_in)
+        {
+            auto last = std::min(bounds.size(), first + max_fan_in);
+            if (last - first == 1)
+            {
+                merged.push_back(bounds[first]);
+                continue;
+            }
+            auto runs = std::vector<external::RunReader<Record>>();
+            runs.reserve(last - first);
+            auto heap = std::vector<size_t>();
+            for (auto r = first; r < last; ++r)
+            {
+                runs.emplace_back(file, bounds[r].first, bounds[r].second, block);
+                heap.push_back(heap.size());
+            }
+            // as later(), over these runs
+            auto later = [&runs](size_t r1, size_t r2) {
+                return vertically_less(endpoint(runs[r1].front()), endpoint(runs[r2].front()));
+            };
+            std::make_heap(heap.begin(), heap.end(), later);
+
+            auto start = end;
+            while (!heap.empty())
+            {
+                std::pop_heap(heap.begin(), heap.end(), later);
+                auto &run = runs[heap.back()];
+                buffer.push_back(run.front());
+                run.pop();
+                if (run.empty())
+                {
+                    heap.pop_back();
+                }
+                else
+                {
+                    std::push_heap(heap.begin(), heap.end(), later);
+                }
+                if (buffer.size() == block)
+                {
+                    flush();
+                }
+            }
+            if (!buffer.empty())
+            {
+                flush();
+            }
+            merged.push_back({start, end});
+        }
+        return merged;
+    }
+
+    const Record &front() const
+    {
+        return readers.empty() ? records[position] : readers[heap.front()].front();
+    }
+
+    // heap order of the runs, the one with the next event on top
+    auto later() const
+    {
+        return [this](size_t r1, size_t r2) {
+            return vertically_less(endpoint(readers[r1].front()), endpoint(readers[r2].front()));
+        };
+    }
+
+    external::TemporaryFile file;
+    // all of them when they fit in memory
+    std::vector<Record> records;
+    size_t position = 0;
+    std::vector<external::RunReader<Record>> readers;
+    std::vector<size_t> heap;
+};
+
+// EventQueue within a memory budget in bytes. Once the events in memory
+// would take more than half of it, the half the sweep gets to last is
+// written to disk as a sorted run, and the runs are merged back as the
+// sweep reaches them. The other half of the budget is for reading the
+// runs, one block and one read ahead each; past max_runs runs the smaller
+// half of them is merged into one first.
+template <class Kernel>
+class SpillingEventQueue
+{
+  public:
+    using Event = ::Event<Kernel>;
+    static_assert(std::is_trivially_copyable<Event>::value, "events are written as they are");
+
+    static constexpr size_t max_runs = 16;
+
+    explicit SpillingEventQueue(size_t memory,
+                                const std::string &directory = std::filesystem::temp_directory_path().string())
+        : file(directory), capacity(std::max<size_t>(2, memory / 2 / (sizeof(Event) + node_overhead))),
+          block(std::max<size_t>(1, memory / 2 / (2 * max_runs * sizeof(Event))))
+    {
+    }
+
+    bool empty() const
+    {
+        return events.empty() && heap.empty();
+    }
+
+    const Event &top() const
+    {
+        return from_disk() ? readers[heap.front()].front() : events.top();
+    }
+
+    void pop()
+    {
+        if (!from_disk())
+        {
+            events.pop();
+            return;
+        }
+        io_statistics().reloaded += sizeof(Event);
+        next_event(heap);
+        if (heap.empty())
+        {
+            // everything on disk was read, start over
+            readers.clear();
+            end = 0;
+        }
+    }
+
+    void insert(const Event &event)
+    {
+        events.insert(event);
+        spill();
+    }
+
+    // may keep the event twice if it is on disk already
+    void insert_once(const Event &event)
+    {
+        events.insert_once(event);
+        spill();
+    }
+
+  private:
+    // per event in the multiset of EventQueue
+    static constexpr size_t node_overhead = 32;
+
+    bool from_disk() const
+    {
+        return !heap.empty() &&
+               (events.empty() || Kernel::vertically_less(events.top().point, readers[heap.front()].front().point));
+    }
+
+    // heap order of the runs, the one with the next event on top
+    auto later() const
+    {
+        return [this](size_t r1, size_t r2) {
+            return Kernel::vertically_less(readers[r1].front().point, readers[r2].front().point);
+        };
+    }
+
+    // pops the next event of a heap of runs
+    void next_event(std::vector<size_t> &runs)
+    {
+        std::pop_heap(runs.begin(), runs.end(), later());
+        auto &reader = readers[runs.back()];
+        reader.pop();
+        if (reader.empty())
+        {
+            runs.pop_back();
+        }
+        else
+        {
+            std::push_heap(runs.begin(), runs.end(), later());
+        }
+    }
+
+    void spill()
+    {
+        if (events.size() <= capacity)
+        {
+            return;
+        }
+        if (heap.size() == max_runs)
+        {
+            compact();
+        }
+        auto first = end;
+        auto run = events.take_last(events.size() / 2);
+        io_statistics().spilled += run.size() * sizeof(Event);
+        write(run);
+        add_run(first, end);
+    }
+
+    // The smaller half of the runs merged into one, written in blocks, so
+    // that an event is rewritten about log(spilled / capacity) times.
+    void compact()
+    {
+        std::sort(heap.begin(), heap.end(),
+                  [this](size_t r1, size_t r2) { return readers[r1].remaining() < readers[r2].remaining(); });
+        auto merged = std::vector<size_t>(heap.begin(), heap.begin() + heap.size() / 2);
+        heap.erase(heap.begin(), heap.begin() + merged.size());
+        std::make_heap(merged.begin(), merged.end(), later());
+
+        auto first = end;
+        auto buffer = std::vector<Event>();
+        buffer.reserve(block);
+        while (!merged.empty())
+        {
+            buffer.push_back(readers[merged.front()].front());
+            next_event(merged);
+            if (buffer.size() == block)
+            {
+                write(buffer);
+                buffer.clear();
+            }
+        }
+        write(buffer);
+
+        auto live = std::vector<external::RunReader<Event>>();
+        for (auto r : heap)
+        {
+            live.push_back(std::move(readers[r]));
+        }
+        readers = std::move(live);
+        heap.resize(readers.size());
+        std::iota(heap.begin(), heap.end(), 0);
+        std::make_heap(heap.begin(), heap.end(), later());
+        add_run(first, end);
+    }
+
+    void write(const std::vector<Event> &run)
+    {
+        if (run.empty())
+        {
+            return;
+        }
+        ++io_statistics().writes;
+        io_statistics().bytes_written += run.size() * sizeof(Event);
+        file.write(run.data(), run.size() * sizeof(Event), end * sizeof(Event));
+        end += run.size();
+    }
+
+    void add_run(size_t first, size_t last)
+    {
+        readers.emplace_back(file, first, last, block);
+        heap.push_back(readers.size() - 1);
+        std::push_heap(heap.begin(), heap.end(), later());
+    }
+
+    external::TemporaryFile file;
+    size_t capacity, block;
+    EventQueue<Kernel> events;
+    std::vector<external::RunReader<Event>> readers;
+    std::vector<size_t> heap;
+    size_t end = 0; // of the runs in the file, in events
+};
+
+// sweep_line within a memory budget in bytes besides the status, half of
+// it for the endpoint events (ExternalEndpoints), half for the events
+// found on the way (SpillingEventQueue)
+template <class Segments, class Observer>
+void external_sweep_line(const Segments &segments, Observer &&observer, size_t memory,
+                         const std::string &directory = std::filesystem::temp_directory_path().string())
+{
+    auto endpoints = ExternalEndpoints<Segments>(segments, memory / 2, directory);
+    auto events = SpillingEventQueue<typename SegmentTraits<Segments>::Kernel>(memory / 2, directory);
+    sweep_line(segments, endpoints, events, observer);
+}
+
+#endif
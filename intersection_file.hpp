@@ -0,0 +1,380 @@
+#ifndef INTERSECTION_FILE_HPP
+#define INTERSECTION_FILE_HPP
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+
+#include "segment_file.hpp"
+
+// Binary intersection files: a 64 byte header, then one record per pair
+// of segments meeting at a point, (x, y, i, j). Raw records are two
+// little-endian doubles and two uint64. Delta encoded records are varints
+// of the differences with the previous record, zigzagged: x and y as
+// order-preserving integer keys of the doubles, or as grid coordinates
+// when quantized (a point being (x0 + scale * qx, y0 + scale * qy)), i
+// and j from the previous i and j. Records in sweep order have close y,
+// and, when the input is spatially ordered, ids close to those of the
+// previous record.
+// On the random segments of the output demo, lossless delta records are
+// about 1.6x smaller than raw ones (2.6x smaller than CSV), 1.85x (3x)
+// with the segments numbered in sweep order; only the lossy quantized ones
+// reach 3-5x, about 2.5x smaller than raw (4x than CSV), 3x (4.8x) with
+// the segments in sweep order.
+
+namespace intersection_file
+{
+constexpr char magic[8] = {'C', 'R', 'O', 'S', 'S', 'I', 'N', 'G'};
+constexpr uint32_t version = 2;
+
+enum Flags : uint32_t
+{
+    delta = 1,
+    quantized = 2,
+};
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t count;
+    double scale, x0, y0;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(Header) == 64, "the header is 64 bytes");
+
+struct RawRecord
+{
+    double x, y;
+    uint64_t i, j;
+};
+
+// a point where segments i and j meet, as read back
+struct Record
+{
+    vector2<double> point;
+    uint64_t i, j;
+};
+
+inline uint64_t zigzag(int64_t value)
+{
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value)
+{
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+// ordered as the doubles are, negative ones below positive ones
+inline uint64_t ordered_key(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits >> 63 ? ~bits : bits | (uint64_t(1) << 63);
+}
+
+inline double from_ordered_key(uint64_t key)
+{
+    auto bits = key >> 63 ? key & ~(uint64_t(1) << 63) : ~key;
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void put_varint(std::vector<char> &bytes, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(char(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(char(value));
+}
+
+// moves p past the varint, throws past end
+inline uint64_t get_varint(const char *&p, const char *end)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p == end)
+        {
+            break;
+        }
+        auto byte = uint8_t(*p++);
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (byte < 0x80)
+        {
+            return value;
+        }
+    }
+    throw std::runtime_error("truncated intersection file");
+}
+} // namespace intersection_file
+
+// Writes an intersection file as the records come. The records are encoded
+// into one buffer while the other one is written by a background thread.
+// A positive quantum quantizes the coordinates of delta encoded records to
+// a grid of that step from the origin (x0, y0), which loses precision.
+class IntersectionFileWriter
+{
+  public:
+    explicit IntersectionFileWriter(const std::string &path, bool delta = true, double quantum = 0, double x0 = 0,
+                                    double y0 = 0, size_t buffer_size = 1 << 20)
+        : path(path), output(path, std::ios::binary), buffer_size(buffer_size)
+    {
+        if (quantum > 0 && !delta)
+        {
+            throw std::invalid_argument("quantized coordinates are delta encoded");
+        }
+        std::memcpy(header.magic, intersection_file::magic, sizeof(header.magic));
+        header.version = intersection_file::version;
+        header.flags = (delta ? uint32_t(intersection_file::delta) : 0) | (quantum > 0 ? uint32_t(intersection_file::quantized) : 0);
+        header.scale = quantum > 0 ? quantum : 1;
+        header.x0 = quantum > 0 ? x0 : 0;
+        header.y0 = quantum > 0 ? y0 : 0;
+        // the count is known at the end
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        check();
+        filling.reserve(buffer_size + 4 * 10);
+        writing.reserve(buffer_size + 4 * 10);
+    }
+
+    IntersectionFileWriter(const IntersectionFileWriter &) = delete;
+    IntersectionFileWriter &operator=(const IntersectionFileWriter &) = delete;
+
+    void add(const vector2<double> &point, uint64_t i, uint64_t j)
+    {
+        using namespace intersection_file;
+        if (!(header.flags & delta))
+        {
+            auto record = RawRecord{point.x, point.y, i, j};
+            auto bytes = reinterpret_cast<const char *>(&record);
+            filling.insert(filling.end(), bytes, bytes + sizeof(record));
+        }
+        else
+        {
+            int64_t x, y;
+            if (header.flags & quantized)
+            {
+                x = std::llround((point.x - header.x0) / header.scale);
+                y = std::llround((point.y - header.y0) / header.scale);
+            }
+            else
+            {
+                x = int64_t(ordered_key(point.x));
+                y = int64_t(ordered_key(point.y));
+            }
+            // wrapping differences
+            put_varint(filling, zigzag(int64_t(uint64_t(y) - uint64_t(previous.y))));
+            put_varint(filling, zigzag(int64_t(uint64_t(x) - uint64_t(previous.x))));
+            put_varint(filling, zigzag(int64_t(i - previous.i)));
+            put_varint(filling, zigzag(int64_t(j - previous.j)));
+            previous = {x, y, i, j};
+        }
+        ++header.count;
+        if (filling.size() >= buffer_size)
+        {
+            flush();
+        }
+    }
+
+    void finish()
+    {
+        flush();
+        wait();
+        output.seekp(0);
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.close();
+        check();
+    }
+
+    size_t size() const
+    {
+        return header.count;
+    }
+
+  private:
+    struct Previous
+    {
+        int64_t x = 0, y = 0;
+        uint64_t i = 0, j = 0;
+    };
+
+    // hands the filled buffer to the background thread
+    void flush()
+    {
+        wait();
+        std::swap(filling, writing);
+        filling.clear();
+        written = std::async(std::launch::async, [this]() {
+            output.write(writing.data(), writing.size());
+        });
+    }
+
+    void wait()
+    {
+        if (written.valid())
+        {
+            written.get();
+        }
+        check();
+    }
+
+    void check()
+    {
+        if (!output)
+        {
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+
+    std::string path;
+    std::ofstream output;
+    size_t buffer_size;
+    intersection_file::Header header = intersection_file::Header();
+    Previous previous;
+    std::vector<char> filling, writing;
+    std::future<void> written; // destroyed first, it waits for the write
+};
+
+// An intersection file mapped read-only, its records read in order through
+// an input iterator.
+class IntersectionFile
+{
+  public:
+    explicit IntersectionFile(const std::string &path) : file(path)
+    {
+        using namespace intersection_file;
+        if (file.size() < sizeof(Header))
+        {
+            throw std::runtime_error(path + " is not an intersection file");
+        }
+        const auto &header = this->header();
+        auto records = file.size() - sizeof(Header);
+        if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != version ||
+            ((header.flags & quantized) && !(header.flags & delta)) ||
+            (!(header.flags & delta) && records != header.count * sizeof(RawRecord)))
+        {
+            throw std::runtime_error(path + " is not an intersection file");
+        }
+    }
+
+    const intersection_file::Header &header() const
+    {
+        return *reinterpret_cast<const intersection_file::Header *>(file.data());
+    }
+
+    size_t size() const
+    {
+        return header().count;
+    }
+
+    class Iterator
+    {
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = intersection_file::Record;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        Iterator(const IntersectionFile &file, size_t index)
+            : file(&file), index(index), p(file.file.data() + sizeof(intersection_file::Header)),
+              end(file.file.data() + file.file.size())
+        {
+            if (index < file.size())
+            {
+                read();
+            }
+        }
+
+        reference operator*() const
+        {
+            return record;
+        }
+
+        pointer operator->() const
+        {
+            return &record;
+        }
+
+        Iterator &operator++()
+        {
+            if (++index < file->size())
+            {
+                read();
+            }
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const
+        {
+            return index == other.index;
+        }
+
+        bool operator!=(const Iterator &other) const
+        {
+            return index != other.index;
+        }
+
+      private:
+        void read()
+        {
+            using namespace intersection_file;
+            const auto &header = file->header();
+            if (!(header.flags & delta))
+            {
+                RawRecord raw;
+                std::memcpy(&raw, p, sizeof(raw));
+                p += sizeof(raw);
+                record = {{raw.x, raw.y}, raw.i, raw.j};
+                return;
+            }
+            y += uint64_t(unzigzag(get_varint(p, end)));
+            x += uint64_t(unzigzag(get_varint(p, end)));
+            record.i += uint64_t(unzigzag(get_varint(p, end)));
+            record.j += uint64_t(unzigzag(get_varint(p, end)));
+            if (header.flags & quantized)
+            {
+                record.point = {header.x0 + header.scale * double(int64_t(x)),
+                                header.y0 + header.scale * double(int64_t(y))};
+            }
+            else
+            {
+                record.point = {from_ordered_key(x), from_ordered_key(y)};
+            }
+        }
+
+        const IntersectionFile *file;
+        size_t index;
+        const char *p, *end;
+        uint64_t x = 0, y = 0; // keys or grid coordinates of the previous record
+        intersection_file::Record record = {{0, 0}, 0, 0};
+    };
+
+    // the records are decoded as the iterator moves, from the start
+    Iterator begin() const
+    {
+        return Iterator(*this, 0);
+    }
+
+    Iterator end() const
+    {
+        return Iterator(*this, size());
+    }
+
+  private:
+    MappedFile file;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef INTERVAL_HPP
+#define INTERVAL_HPP
+
+#include <cfenv>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <ostream>
+
+#include "vector2.hpp"
+
+// The interval operations round their bounds outwards and rely on the
+// rounding mode being FE_UPWARD, so they must be evaluated inside an
+// upward_rounding scope: the upper bound is rounded up directly and the
+// lower bound is computed as -(-lower) rounded up. Compile with
+// -frounding-math so that nothing is folded or moved across the scope;
+// GCC has no other switch for it, clang takes the pragma as well.
+
+#ifdef __clang__
+#pragma STDC FENV_ACCESS ON
+#endif
+
+class upward_rounding
+{
+  public:
+    upward_rounding() : previous(std::fegetround())
+    {
+        std::fesetround(FE_UPWARD);
+    }
+
+    ~upward_rounding()
+    {
+        std::fesetround(previous);
+    }
+
+    upward_rounding(const upward_rounding &) = delete;
+    upward_rounding &operator=(const upward_rounding &) = delete;
+
+  private:
+    int previous;
+};
+
+struct interval
+{
+    double lo, hi;
+
+    interval() : lo(0), hi(0) {}
+    interval(double value) : lo(value), hi(value) {}
+    interval(double lo, double hi) : lo(lo), hi(hi) {}
+
+    static interval whole()
+    {
+        return {-std::numeric_limits<double>::infinity(),
+                std::numeric_limits<double>::infinity()};
+    }
+
+    bool contains_zero() const
+    {
+        return lo <= 0 && 0 <= hi;
+    }
+
+    double midpoint() const
+    {
+        return lo / 2 + hi / 2;
+    }
+
+    // -1 or 1 if the sign is certain, 0 otherwise
+    int certain_sign() const
+    {
+        return lo > 0 ? 1 : hi < 0 ? -1 : 0;
+    }
+
+    friend interval operator-(interval a)
+    {
+        return {-a.hi, -a.lo};
+    }
+
+    friend interval operator+(interval a, interval b)
+    {
+        return {-(-a.lo - b.lo), a.hi + b.hi};
+    }
+
+    friend interval operator-(interval a, interval b)
+    {
+        return {-(b.hi - a.lo), a.hi - b.lo};
+    }
+
+    friend interval operator*(interval a, interval b)
+    {
+        double hi = std::max(std::max(a.lo * b.lo, a.lo * b.hi),
+                             std::max(a.hi * b.lo, a.hi * b.hi));
+        double lo = std::max(std::max(-a.lo * b.lo, -a.lo * b.hi),
+                             std::max(-a.hi * b.lo, -a.hi * b.hi));
+        return {-lo, hi};
+    }
+
+    friend interval operator/(interval a, interval b)
+    {
+        if (b.contains_zero())
+        {
+            return whole();
+        }
+        double hi = std::max(std::max(a.lo / b.lo, a.lo / b.hi),
+                             std::max(a.hi / b.lo, a.hi / b.hi));
+        double lo = std::max(std::max(-a.lo / b.lo, -a.lo / b.hi),
+                             std::max(-a.hi / b.lo, -a.hi / b.hi));
+        return {-lo, hi};
+    }
+
+    interval &operator+=(interval other)
+    {
+        return *this = *this + other;
+    }
+
+    interval &operator-=(interval other)
+    {
+        return *this = *this - other;
+    }
+
+    interval &operator*=(interval other)
+    {
+        return *this = *this * other;
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &output, interval value)
+{
+    output << "[" << value.lo << ", " << value.hi << "]";
+    return output;
+}
+
+// 2d vector of intervals, the generic vector2 only scales by plain scalars
+template <>
+struct vector2<interval>
+{
+    interval x, y;
+
+    vector2() {}
+    vector2(interval x, interval y) : x(x), y(y) {}
+    vector2(const vector2<double> &point) : x(point.x), y(point.y) {}
+
+    friend vector2<interval> operator-(vector2<interval> vec)
+    {
+        return {-vec.x, -vec.y};
+    }
+
+    vector2<interval> operator+(const vector2<interval> &other) const
+    {
+        return {x + other.x, y + other.y};
+    }
+
+    vector2<interval> operator-(const vector2<interval> &other) const
+    {
+        return {x - other.x, y - other.y};
+    }
+
+    vector2<interval> operator*(interval scalar) const
+    {
+        return {x * scalar, y * scalar};
+    }
+
+    vector2<interval> operator/(interval scalar) const
+    {
+        return {x / scalar, y / scalar};
+    }
+
+    // the midpoint of the box
+    vector2<double> midpoint() const
+    {
+        return {x.midpoint(), y.midpoint()};
+    }
+};
+
+#endif
@@ -0,0 +1,431 @@
+#ifndef KERNEL_HPP
+#define KERNEL_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <cassert>
+#include <utility>
+
+#include "vector2.hpp"
+#include "predicates.hpp"
+#include "interval.hpp"
+
+template <class T>
+bool vertically_less(const T &a, const T &b)
+{
+    //  y
+    //   ^
+    //   |  .5
+    //   |    .3 .4
+    //   |    .2
+    //   | .1
+    //   ------> x
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+template <class T>
+int sign(const T &value)
+{
+    return (T(0) < value) - (value < T(0));
+}
+
+// A kernel tells the sweep how to compute with points:
+//  - Point is the type of the input endpoints,
+//  - EventPoint is the type of the event points (endpoints and intersections),
+//  - orientation(a, b, p) is the sign of cross(b - a, p - a),
+//  - orientation(a, b, c, d) is the sign of cross(b - a, d - c),
+//  - intersection_point(a, b, c, d) intersects the lines ab and cd,
+//  - point_error is how far the double value of an event point can be
+//    from a segment the sweep finds through it, relative to the largest
+//    coordinate.
+
+// Plain double precision kernel
+struct DoubleKernel
+{
+    using Point = vector2<double>;
+    using EventPoint = vector2<double>;
+
+    // an orientation of zero with a rounded point: the rounding of the
+    // differences and the error of the cross product over the length
+    static constexpr double point_error = 2 * cross_bound_a + 4 * predicate_epsilon;
+
+    static EventPoint to_event_point(const Point &p)
+    {
+        return p;
+    }
+
+    static vector2<double> to_double(const Point &p)
+    {
+        return p;
+    }
+
+    static Point from_double(const vector2<double> &p)
+    {
+        return p;
+    }
+
+    static bool vertically_less(const EventPoint &a, const EventPoint &b)
+    {
+        return ::vertically_less(a, b);
+    }
+
+    static bool equal(const EventPoint &a, const EventPoint &b)
+    {
+        return a == b;
+    }
+
+    static int orientation(const Point &a, const Point &b, const EventPoint &p)
+    {
+        return sign(cross(b - a, p - a));
+    }
+
+    static int orientation(const Point &a, const Point &b, const Point &c, const Point &d)
+    {
+        return sign(cross(b - a, d - c));
+    }
+
+    static EventPoint intersection_point(const Point &a, const Point &b, const Point &c, const Point &d)
+    {
+        auto x_diff = vector2<double>(a.x - b.x, c.x - d.x);
+        auto y_diff = vector2<double>(a.y - b.y, c.y - d.y);
+        double det = cross(x_diff, y_diff);
+        auto cr = Point(cross(a, b), cross(c, d));
+        // clamped into both bounding boxes, which makes it exact for axis
+        // parallel segments and keeps it within the y range of both
+        auto clamp = [](double value, double p, double q, double r, double s) {
+            auto low = std::max(std::min(p, q), std::min(r, s));
+            auto high = std::min(std::max(p, q), std::max(r, s));
+            return std::min(std::max(value, low), high);
+        };
+        return Point(clamp(cross(cr, x_diff) / det, a.x, b.x, c.x, d.x),
+                     clamp(cross(cr, y_diff) / det, a.y, b.y, c.y, d.y));
+    }
+};
+
+// Double kernel whose predicates are exact for the points they are given:
+// evaluated in floating point first and with expansion arithmetic when the
+// sign is uncertain. The intersection points are still rounded doubles and
+// the status is ordered against them, so the sweep is only as exact as
+// those points; on degenerate input, e.g. polylines on a fine grid, it can
+// lose a segment, where IntervalKernel and ExactKernel do not.
+struct FilteredKernel : DoubleKernel
+{
+    static int orientation(const Point &a, const Point &b, const EventPoint &p)
+    {
+        return filtered_cross(a.x, a.y, b.x, b.y, a.x, a.y, p.x, p.y);
+    }
+
+    static int orientation(const Point &a, const Point &b, const Point &c, const Point &d)
+    {
+        return filtered_cross(a.x, a.y, b.x, b.y, c.x, c.y, d.x, d.y);
+    }
+};
+
+// Double kernel whose intersection points carry certified interval bounds.
+// Predicates on event points are decided by the boxes when they do not
+// overlap zero (or each other), and escalate to an exact evaluation with
+// expansions of the defining input points only when they do. Escalations
+// are rare (about 1 in 20000 in bench); the cost is in the first stages,
+// comparing the larger event points and, for orientations, switching the
+// rounding mode, which a round to nearest test against the box skips in
+// most cases.
+struct IntervalKernel : FilteredKernel
+{
+    using FilteredKernel::orientation;
+    using FilteredKernel::to_double;
+
+    // the points are exact, their double values rounded to nearest
+    static constexpr double point_error = predicate_epsilon;
+
+    struct EventPoint
+    {
+        vector2<interval> box;
+        vector2<double> approximation;
+        // the input point a, or the intersection of the lines ab and cd
+        Point a, b, c, d;
+        bool is_intersection;
+    };
+
+    // exact point as (x / w, y / w)
+    struct Homogeneous
+    {
+        expansion x, y, w;
+    };
+
+    static Homogeneous exact(const EventPoint &p)
+    {
+        if (!p.is_intersection)
+        {
+            return {p.a.x, p.a.y, 1};
+        }
+        auto diff = [](double u, double v) {
+            return expansion(u) - expansion(v);
+        };
+        auto rx = diff(p.b.x, p.a.x), ry = diff(p.b.y, p.a.y);
+        auto sx = diff(p.d.x, p.c.x), sy = diff(p.d.y, p.c.y);
+        auto w = rx * sy - ry * sx;
+        auto t = diff(p.c.x, p.a.x) * sy - diff(p.c.y, p.a.y) * sx;
+        return {expansion(p.a.x) * w + rx * t, expansion(p.a.y) * w + ry * t, w};
+    }
+
+    static EventPoint to_event_point(const Point &p)
+    {
+        return {p, p, p, p, p, p, false};
+    }
+
+    static vector2<double> to_double(const EventPoint &p)
+    {
+        return p.approximation;
+    }
+
+    static bool vertically_less(const EventPoint &a, const EventPoint &b)
+    {
+        if (same_definition(a, b))
+        {
+            return false;
+        }
+        int y = compare(a, b, &vector2<interval>::y, &Homogeneous::y);
+        return y < 0 || (y == 0 && compare(a, b, &vector2<interval>::x, &Homogeneous::x) < 0);
+    }
+
+    static bool equal(const EventPoint &a, const EventPoint &b)
+    {
+        if (same_definition(a, b))
+        {
+            return true;
+        }
+        return compare(a, b, &vector2<interval>::y, &Homogeneous::y) == 0 &&
+               compare(a, b, &vector2<interval>::x, &Homogeneous::x) == 0;
+    }
+
+    static int orientation(const Point &a, const Point &b, const EventPoint &p)
+    {
+        if (!p.is_intersection)
+        {
+            return FilteredKernel::orientation(a, b, p.a);
+        }
+        if (on_line(a, b, p.a, p.b) || on_line(a, b, p.c, p.d))
+        {
+            return 0;
+        }
+
+        auto &statistics = predicate_statistics();
+        ++statistics.evaluations;
+        // against the midpoint of the box in round to nearest first, the
+        // point being at most |ux| ry + |uy| rx further from the line; this
+        // decides most cases without switching the rounding mode
+        auto m = p.box.midpoint();
+        auto rx = std::max(p.box.x.hi - m.x, m.x - p.box.x.lo), ry = std::max(p.box.y.hi - m.y, m.y - p.box.y.lo);
+        auto ux = b.x - a.x, uy = b.y - a.y;
+        auto left = ux * (m.y - a.y), right = uy * (m.x - a.x);
+        auto det = left - right;
+        auto bound = cross_bound_a * (std::abs(left) + std::abs(right)) +
+                     (1 + 16 * predicate_epsilon) * (std::abs(ux) * ry + std::abs(uy) * rx);
+        if (std::abs(det) > bound)
+        {
+            return sign(det);
+        }
+
+        int result;
+        {
+            upward_rounding rounding;
+            auto ia = vector2<interval>(a);
+            result = cross(vector2<interval>(b) - ia, p.box - ia).certain_sign();
+        }
+        if (result != 0)
+        {
+            return result;
+        }
+
+        ++statistics.fallbacks;
+        auto e = exact(p);
+        auto ex = expansion(b.x) - a.x, ey = expansion(b.y) - a.y;
+        auto value = ex * (e.y - expansion(a.y) * e.w) - ey * (e.x - expansion(a.x) * e.w);
+        return value.sign() * e.w.sign();
+    }
+
+    static EventPoint intersection_point(const Point &a, const Point &b, const Point &c, const Point &d)
+    {
+        auto p = EventPoint{{}, DoubleKernel::intersection_point(a, b, c, d), a, b, c, d, true};
+        upward_rounding rounding;
+        auto ia = vector2<interval>(a);
+        auto ic = vector2<interval>(c);
+        auto r = vector2<interval>(b) - ia;
+        auto s = vector2<interval>(d) - ic;
+        p.box = ia + r * (cross(ic - ia, s) / cross(r, s));
+        return p;
+    }
+
+  private:
+    // the same input points or intersection of the same lines
+    static bool same_definition(const EventPoint &a, const EventPoint &b)
+    {
+        if (a.is_intersection != b.is_intersection)
+        {
+            return false;
+        }
+        if (!a.is_intersection)
+        {
+            return a.a == b.a;
+        }
+        return (on_line(a.a, a.b, b.a, b.b) && on_line(a.c, a.d, b.c, b.d)) ||
+               (on_line(a.a, a.b, b.c, b.d) && on_line(a.c, a.d, b.a, b.b));
+    }
+
+    // the segment ab is the segment cd
+    static bool on_line(const Point &a, const Point &b, const Point &c, const Point &d)
+    {
+        return (a == c && b == d) || (a == d && b == c);
+    }
+
+    // compare one coordinate, by the boxes if they are apart and exactly otherwise
+    static int compare(const EventPoint &a, const EventPoint &b,
+                       interval vector2<interval>::*box, expansion Homogeneous::*coordinate)
+    {
+        auto &statistics = predicate_statistics();
+        ++statistics.evaluations;
+        if ((a.box.*box).hi < (b.box.*box).lo)
+        {
+            return -1;
+        }
+        if ((b.box.*box).hi < (a.box.*box).lo)
+        {
+            return 1;
+        }
+        if (!a.is_intersection && !b.is_intersection)
+        {
+            return 0; // degenerate boxes that overlap
+        }
+
+        ++statistics.fallbacks;
+        auto ea = exact(a);
+        auto eb = exact(b);
+        auto value = ea.*coordinate * eb.w - eb.*coordinate * ea.w;
+        return value.sign() * ea.w.sign() * eb.w.sign();
+    }
+};
+
+// sign of a * b - c * d, the products are evaluated with 256 bits
+inline int compare_products(__int128 a, __int128 b, __int128 c, __int128 d)
+{
+    using u128 = unsigned __int128;
+
+    int ab = sign(a) * sign(b);
+    int cd = sign(c) * sign(d);
+    if (ab != cd || ab == 0)
+    {
+        return sign(ab - cd);
+    }
+
+    // |x| * |y| as (hi, lo) 128-bit limbs
+    auto multiply = [](u128 x, u128 y) {
+        const u128 mask = ~uint64_t(0);
+        u128 x0 = x & mask, x1 = x >> 64;
+        u128 y0 = y & mask, y1 = y >> 64;
+        u128 p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+        u128 mid = (p00 >> 64) + (p01 & mask) + (p10 & mask);
+        u128 lo = (p00 & mask) | (mid << 64);
+        u128 hi = p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+        return std::make_pair(hi, lo);
+    };
+    auto magnitude = [](__int128 x) {
+        return x < 0 ? -u128(x) : u128(x);
+    };
+
+    auto p = multiply(magnitude(a), magnitude(b));
+    auto q = multiply(magnitude(c), magnitude(d));
+    int result = p < q ? -1 : q < p ? 1 : 0;
+    return ab > 0 ? result : -result;
+}
+
+// Exact integer kernel: int64 endpoints, __int128 predicates and rational
+// intersection points. Coordinates must stay below max_coordinate in
+// magnitude so that no intermediate value overflows 128 bits.
+struct ExactKernel
+{
+    using Point = vector2<int64_t>;
+
+    // homogeneous (x / w, y / w) with w > 0
+    struct EventPoint
+    {
+        __int128 x, y, w;
+    };
+
+    static constexpr int64_t max_coordinate = int64_t(1) << 40;
+
+    // the points are exact, their double values rounded to nearest
+    static constexpr double point_error = predicate_epsilon;
+
+    static EventPoint to_event_point(const Point &p)
+    {
+        return {p.x, p.y, 1};
+    }
+
+    static vector2<double> to_double(const Point &p)
+    {
+        return {double(p.x), double(p.y)};
+    }
+
+    static vector2<double> to_double(const EventPoint &p)
+    {
+        return {double((long double)p.x / p.w), double((long double)p.y / p.w)};
+    }
+
+    // snap a double point to the integer grid
+    static Point from_double(const vector2<double> &p)
+    {
+        assert(std::abs(p.x) < max_coordinate && std::abs(p.y) < max_coordinate);
+        return {std::llround(p.x), std::llround(p.y)};
+    }
+
+    static bool vertically_less(const EventPoint &a, const EventPoint &b)
+    {
+        int y = compare_products(a.y, b.w, b.y, a.w);
+        return y < 0 || (y == 0 && compare_products(a.x, b.w, b.x, a.w) < 0);
+    }
+
+    static bool equal(const EventPoint &a, const EventPoint &b)
+    {
+        return compare_products(a.y, b.w, b.y, a.w) == 0 &&
+               compare_products(a.x, b.w, b.x, a.w) == 0;
+    }
+
+    static int orientation(const Point &a, const Point &b, const Point &p)
+    {
+        return sign(__int128(b.x - a.x) * (p.y - a.y) - __int128(b.y - a.y) * (p.x - a.x));
+    }
+
+    static int orientation(const Point &a, const Point &b, const EventPoint &p)
+    {
+        // cross(b - a, p - a) scaled by p.w > 0
+        return compare_products(b.x - a.x, p.y - __int128(a.y) * p.w,
+                                b.y - a.y, p.x - __int128(a.x) * p.w);
+    }
+
+    static int orientation(const Point &a, const Point &b, const Point &c, const Point &d)
+    {
+        auto u = b - a;
+        auto v = d - c;
+        return sign(__int128(u.x) * v.y - __int128(u.y) * v.x);
+    }
+
+    static EventPoint intersection_point(const Point &a, const Point &b, const Point &c, const Point &d)
+    {
+        // a + (b - a) * t, t = cross(c - a, d - c) / cross(b - a, d - c)
+        auto cross128 = [](const Point &u, const Point &v) {
+            return __int128(u.x) * v.y - __int128(u.y) * v.x;
+        };
+        auto r = b - a;
+        auto s = d - c;
+        auto w = cross128(r, s);
+        auto t = cross128(c - a, s);
+        if (w < 0)
+        {
+            w = -w;
+            t = -t;
+        }
+        return {a.x * w + r.x * t, a.y * w + r.y * t, w};
+    }
+};
+
+#endif
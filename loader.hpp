@@ -0,0 +1,378 @@
+#ifndef LOADER_HPP
+#define LOADER_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+#include <algorithm>
+#include <system_error>
+
+#include "json.hpp"
+#include "parallel.hpp"
+#include "sweep_line.hpp"
+#include "segment_file.hpp"
+
+// Segments from text files: CSV lines of ax,ay,bx,by, WKT geometries one
+// per line (LINESTRING, POLYGON and their MULTI forms), and GeoJSON, where
+// consecutive vertices of every line and ring make the segments. CSV and
+// WKT files are mapped and cut into chunks at line boundaries that are
+// parsed in parallel with from_chars. GeoJSON is parsed as a stream: each
+// geometry is dropped from the document once its segments are out, so
+// memory stays at about one feature.
+
+enum class TextFormat
+{
+    csv,
+    wkt,
+    geojson,
+};
+
+// by the file extension
+inline TextFormat text_format(const std::string &path)
+{
+    auto ends_with = [&path](const std::string &extension) {
+        return path.size() >= extension.size() &&
+               path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    };
+    if (ends_with(".csv"))
+    {
+        return TextFormat::csv;
+    }
+    if (ends_with(".wkt"))
+    {
+        return TextFormat::wkt;
+    }
+    if (ends_with(".geojson") || ends_with(".json"))
+    {
+        return TextFormat::geojson;
+    }
+    throw std::invalid_argument("unknown text format: " + path);
+}
+
+namespace loader
+{
+inline void skip_spaces(const char *&p, const char *end)
+{
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    {
+        ++p;
+    }
+}
+
+// moves p past the number, false if there is none
+inline bool parse_number(const char *&p, const char *end, double &value)
+{
+    skip_spaces(p, end);
+    if (p != end && *p == '+')
+    {
+        ++p;
+    }
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+    {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+// the segments between consecutive distinct vertices of a chain, linked
+// into monotone chains
+template <class Kernel>
+void add_chain(const std::vector<vector2<double>> &chain, std::vector<Segment<Kernel>> &segments)
+{
+    auto first = segments.size();
+    for (size_t i = 1; i < chain.size(); ++i)
+    {
+        if (!(chain[i - 1] == chain[i]))
+        {
+            segments.push_back({Kernel::from_double(chain[i - 1]), Kernel::from_double(chain[i])});
+        }
+    }
+    link_monotone_chains(segments, first);
+}
+
+// ax,ay,bx,by with optional columns after, false if the line is not that
+template <class Kernel>
+bool parse_csv(const char *p, const char *end, std::vector<Segment<Kernel>> &segments)
+{
+    double c[4];
+    for (int k = 0; k < 4; ++k)
+    {
+        if (k > 0)
+        {
+            skip_spaces(p, end);
+            if (p == end || *p++ != ',')
+            {
+                return false;
+            }
+        }
+        if (!parse_number(p, end, c[k]))
+        {
+            return false;
+        }
+    }
+    skip_spaces(p, end);
+    if (p != end && *p != ',')
+    {
+        return false;
+    }
+    auto a = vector2<double>(c[0], c[1]), b = vector2<double>(c[2], c[3]);
+    if (!(a == b))
+    {
+        segments.push_back({Kernel::from_double(a), Kernel::from_double(b)});
+    }
+    return true;
+}
+
+// Every innermost parenthesized list of coordinates is a chain, so the
+// geometry tags and nesting need no checking; z and m are ignored.
+template <class Kernel>
+bool parse_wkt(const char *p, const char *end, std::vector<Segment<Kernel>> &segments,
+               std::vector<vector2<double>> &chain)
+{
+    while (p != end)
+    {
+        if (*p++ != '(')
+        {
+            continue;
+        }
+        skip_spaces(p, end);
+        if (p == end || *p == '(')
+        {
+            continue;
+        }
+        chain.clear();
+        for (;;)
+        {
+            double x, y, extra;
+            if (!parse_number(p, end, x) || !parse_number(p, end, y))
+            {
+                return false;
+            }
+            while (parse_number(p, end, extra))
+            {
+            }
+            chain.push_back({x, y});
+            skip_spaces(p, end);
+            if (p == end || (*p != ',' && *p != ')'))
+            {
+                return false;
+            }
+            if (*p++ == ')')
+            {
+                break;
+            }
+        }
+        add_chain<Kernel>(chain, segments);
+    }
+    return true;
+}
+
+// the segments of a GeoJSON geometry object, nothing for points
+template <class Kernel>
+void add_geometry(const nlohmann::json &geometry, std::vector<Segment<Kernel>> &segments,
+                  std::vector<vector2<double>> &chain)
+{
+    auto type = geometry.find("type"), coordinates = geometry.find("coordinates");
+    if (type == geometry.end() || !type->is_string() || coordinates == geometry.end())
+    {
+        return;
+    }
+    auto add = [&](const nlohmann::json &positions) {
+        chain.clear();
+        for (const auto &position : positions)
+        {
+            chain.push_back({position.at(0).get<double>(), position.at(1).get<double>()});
+        }
+        add_chain<Kernel>(chain, segments);
+    };
+    const auto &name = type->get_ref<const std::string &>();
+    if (name == "LineString")
+    {
+        add(*coordinates);
+    }
+    else if (name == "MultiLineString" || name == "Polygon")
+    {
+        for (const auto &line : *coordinates)
+        {
+            add(line);
+        }
+    }
+    else if (name == "MultiPolygon")
+    {
+        for (const auto &polygon : *coordinates)
+        {
+            for (const auto &ring : polygon)
+            {
+                add(ring);
+            }
+        }
+    }
+}
+
+template <class Kernel, class Visitor>
+void load_geojson(const std::string &path, Visitor &&visit, size_t batch_size)
+{
+    using parse_event_t = nlohmann::json::parse_event_t;
+
+    auto input = std::ifstream(path, std::ios::binary);
+    if (!input)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    auto batch = std::vector<Segment<Kernel>>();
+    auto chain = std::vector<vector2<double>>();
+    size_t index = 0;
+    // objects are complete at their end, the geometries among them are
+    // turned into segments, then all are discarded
+    nlohmann::json::parse(input, [&](int, parse_event_t event, nlohmann::json &parsed) {
+        if (event != parse_event_t::object_end)
+        {
+            return true;
+        }
+        add_geometry<Kernel>(parsed, batch, chain);
+        if (batch.size() >= batch_size)
+        {
+            visit(index++, std::move(batch));
+            batch = {};
+        }
+        return false;
+    });
+    if (!batch.empty())
+    {
+        visit(index, std::move(batch));
+    }
+}
+} // namespace loader
+
+// Calls visit(index, batch) with the segments of the file in batches,
+// the index being the position of the batch in the file, concurrently as
+// overlapping_boxes does for CSV and WKT, whose chunks are about
+// chunk_size bytes. The segments of WKT and GeoJSON lines and rings are
+// linked into monotone chains, Segment::next being an index in the batch.
+// A first CSV line that does not parse is taken as the header, other lines
+// that do not parse throw.
+template <class Kernel, class Visitor>
+void load_segments(const std::string &path, TextFormat format, Visitor &&visit, size_t chunk_size = 1 << 24)
+{
+    if (format == TextFormat::geojson)
+    {
+        loader::load_geojson<Kernel>(path, visit, chunk_size / sizeof(Segment<Kernel>));
+        return;
+    }
+
+    auto file = MappedFile(path);
+    const char *text = file.data(), *end = text + file.size();
+    // chunks start after a line break
+    auto starts = std::vector<const char *>{text};
+    for (size_t offset = chunk_size; offset < file.size(); offset += chunk_size)
+    {
+        // a line may be longer than a chunk
+        auto from = std::max(text + offset, starts.back());
+        auto start = static_cast<const char *>(std::memchr(from, '\n', end - from));
+        if (start == nullptr)
+        {
+            break;
+        }
+        starts.push_back(start + 1);
+    }
+    starts.push_back(end);
+
+    // exceptions cannot leave the threads
+    auto errors = std::vector<size_t>(starts.size() - 1, size_t(-1));
+    parallel_for(
+        starts.size() - 1,
+        [&](size_t first, size_t last) {
+            auto batch = std::vector<Segment<Kernel>>();
+            auto chain = std::vector<vector2<double>>();
+            for (auto k = first; k < last; ++k)
+            {
+                batch.clear();
+                for (auto line = starts[k]; line != starts[k + 1];)
+                {
+                    auto line_end = static_cast<const char *>(std::memchr(line, '\n', starts[k + 1] - line));
+                    line_end = line_end == nullptr ? starts[k + 1] : line_end;
+                    auto p = line;
+                    loader::skip_spaces(p, line_end);
+                    bool parsed = p == line_end || (format == TextFormat::csv
+                                                        ? loader::parse_csv<Kernel>(p, line_end, batch)
+                                                        : loader::parse_wkt<Kernel>(p, line_end, batch, chain));
+                    if (!parsed && !(format == TextFormat::csv && line == text))
+                    {
+                        errors[k] = line - text;
+                        break;
+                    }
+                    line = line_end == starts[k + 1] ? line_end : line_end + 1;
+                }
+                if (errors[k] != size_t(-1))
+                {
+                    continue;
+                }
+                visit(k, std::move(batch));
+                batch = {};
+            }
+        },
+        1);
+
+    for (auto error : errors)
+    {
+        if (error != size_t(-1))
+        {
+            // the line as it is, cut short if long
+            auto line = text + error;
+            auto line_end = static_cast<const char *>(std::memchr(line, '\n', end - line));
+            auto length = std::min<size_t>((line_end == nullptr ? end : line_end) - line, 80);
+            throw std::runtime_error(path + ": cannot parse the line at byte " + std::to_string(error) + ": " +
+                                     std::string(line, length));
+        }
+    }
+}
+
+// All the segments of the file, in file order, with their monotone chains.
+template <class Kernel>
+std::vector<Segment<Kernel>> read_segments(const std::string &path, size_t chunk_size = 1 << 24)
+{
+    auto batches = std::vector<std::vector<Segment<Kernel>>>();
+    auto mutex = std::mutex();
+    load_segments<Kernel>(
+        path, text_format(path),
+        [&](size_t index, std::vector<Segment<Kernel>> &&batch) {
+            auto lock = std::lock_guard<std::mutex>(mutex);
+            if (batches.size() <= index)
+            {
+                batches.resize(index + 1);
+            }
+            batches[index] = std::move(batch);
+        },
+        chunk_size);
+
+    size_t size = 0;
+    for (const auto &batch : batches)
+    {
+        size += batch.size();
+    }
+    auto segments = std::vector<Segment<Kernel>>();
+    segments.reserve(size);
+    for (auto &batch : batches)
+    {
+        auto first = segments.size();
+        segments.insert(segments.end(), batch.begin(), batch.end());
+        batch = {};
+        for (auto i = first; i < segments.size(); ++i)
+        {
+            if (segments[i].next != size_t(-1))
+            {
+                segments[i].next += first;
+            }
+        }
+    }
+    return segments;
+}
+
+#endif
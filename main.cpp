@@ -1,341 +1,1526 @@
 #include <iostream>
+#include <cassert>
+#include <cerrno>
 #include <set>
 #include <vector>
 #include <memory>
 #include <random>
 #include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
 
 #include "vector2.hpp"
 #include "plotter.hpp"
+#include "sweep_line.hpp"
+#include "snap_rounding.hpp"
+#include "noding.hpp"
+#include "dcel.hpp"
+#include "boolean.hpp"
+#include "validation.hpp"
+#include "orthogonal.hpp"
+#include "rectangles.hpp"
+#include "coverage.hpp"
+#include "proximity.hpp"
+#include "segment_file.hpp"
+#include "loader.hpp"
+#include "external_sweep.hpp"
+#include "tiling.hpp"
+#include "sharding.hpp"
+#include "adjacency.hpp"
+#include "online_sweep.hpp"
+#include "voronoi.hpp"
+#include "triangulation.hpp"
 
 using namespace std;
 using namespace plt;
 
-template <class T>
-bool vertically_less(const T &a, const T &b)
+using Point = vector2<double>;
+
+Point random_point()
 {
-    //  y
-    //   ^
-    //   |  .5
-    //   |    .3 .4
-    //   |    .2
-    //   | .1
-    //   ------> x
-    return a.y < b.y || a.y == b.y && a.x < b.x;
+    auto generate = []() {
+        static random_device rd;
+        static default_random_engine g(rd());
+        static normal_distribution<double> dist(0, 1);
+        return dist(g);
+    };
+    return {generate(), generate()};
 }
 
-using Point = vector2<double>;
+Segment<DoubleKernel> random_segment()
+{
+    return {random_point(), random_point()};
+}
 
-struct Segment
+vector<Segment<DoubleKernel>> random_segments(size_t num_segments)
 {
-    Point a, b;
+    vector<Segment<DoubleKernel>> segments;
+    segments.reserve(num_segments);
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        segments.push_back(random_segment());
+    }
+    return segments;
+}
+
+// star shaped ring around a random center
+vector<Point> random_ring(size_t num_vertices)
+{
+    static default_random_engine g(random_device{}());
+    auto angle = uniform_real_distribution<double>(0, 2 * M_PI);
+    auto radius = uniform_real_distribution<double>(0.2, 1);
 
-    Point key; // compare point
+    auto angles = vector<double>(num_vertices);
+    for (auto &a : angles)
+    {
+        a = angle(g);
+    }
+    sort(angles.begin(), angles.end());
+
+    auto center = random_point();
+    auto ring = vector<Point>();
+    for (auto a : angles)
+    {
+        auto r = radius(g);
+        ring.push_back(center + Point(r * cos(a), r * sin(a)));
+    }
+    return ring;
+}
 
-    Point &upper_endpoint()
+// scale the segments onto the integer grid of the kernel
+template <class Kernel>
+vector<Segment<Kernel>> convert(const vector<Segment<DoubleKernel>> &segments, double scale)
+{
+    auto result = vector<Segment<Kernel>>();
+    result.reserve(segments.size());
+    for (const auto &segment : segments)
     {
-        return vertically_less(a, b) ? b : a;
+        result.push_back({
+            Kernel::from_double(segment.a * scale),
+            Kernel::from_double(segment.b * scale),
+        });
     }
+    return result;
+}
+
+Plotter &operator<<(Plotter &out, const Point &point)
+{
+    out << new_pt(point.x, point.y);
+    return out;
+}
 
-    const Point &upper_endpoint() const
+template <class Kernel>
+Plotter &operator<<(Plotter &out, const Segment<Kernel> &segment)
+{
+    out << beg_ln << Kernel::to_double(segment.a) << Kernel::to_double(segment.b) << end_ln;
+    return out;
+}
+
+template <class Kernel>
+Plotter &operator<<(Plotter &out, const vector<Segment<Kernel>> &segments)
+{
+    for (const auto &segment : segments)
     {
-        return vertically_less(a, b) ? b : a;
+        out << segment;
     }
+    return out;
+}
+
+template <class Kernel>
+void illustrate(const vector<Segment<Kernel>> &segments)
+{
+    auto reported_points = vector<Point>();
+    sweep_line(segments, [&](const auto &point, const auto &, const auto &status) {
+        // report event point
+        reported_points.push_back(Kernel::to_double(point));
+
+        pout << pt_color("black");
+        for (auto reported_point : reported_points)
+        {
+            pout << reported_point;
+        }
+        pout << ln_color("green") << segments;
+        for (auto segment : status)
+        {
+            pout << ln_color("red") << segment;
+        }
+        pout << show << clear;
+    });
+}
 
-    Point &lower_endpoint()
+// count the event points where at least two segments meet
+template <class Segments>
+size_t count_intersections(const Segments &segments)
+{
+    size_t count = 0;
+    sweep_line(segments, [&count](const auto &, const auto &events, const auto &) {
+        count += events.size() > 1;
+    });
+    return count;
+}
+
+// f() and the seconds it took, only the seconds if it returns nothing
+template <class F>
+auto timed(F &&f)
+{
+    auto start = chrono::steady_clock::now();
+    auto seconds = [&start]() { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); };
+    if constexpr (is_void<decltype(f())>::value)
     {
-        return vertically_less(a, b) ? a : b;
+        f();
+        return seconds();
     }
+    else
+    {
+        auto result = f();
+        return make_pair(move(result), seconds());
+    }
+}
 
-    const Point &lower_endpoint() const
+void benchmark(size_t num_segments)
+{
+    auto segments = random_segments(num_segments);
+    auto filtered_segments = convert<FilteredKernel>(segments, 1);
+    auto interval_segments = convert<IntervalKernel>(segments, 1);
+    auto exact_segments = convert<ExactKernel>(segments, 1 << 20);
+
+    auto inexact = timed([&]() { return count_intersections(segments); });
+    predicate_statistics() = {};
+    auto filtered = timed([&]() { return count_intersections(filtered_segments); });
+    auto statistics = predicate_statistics();
+    predicate_statistics() = {};
+    auto certified = timed([&]() { return count_intersections(interval_segments); });
+    auto interval_statistics = predicate_statistics();
+    auto exact = timed([&]() { return count_intersections(exact_segments); });
+
+    cout << "segments: " << num_segments << endl;
+    cout << "double:   " << inexact.first << " points, " << inexact.second << "s" << endl;
+    cout << "filtered: " << filtered.first << " points, " << filtered.second << "s"
+         << " (x" << filtered.second / inexact.second << ", "
+         << statistics.fallbacks << "/" << statistics.evaluations << " exact fallbacks)" << endl;
+    cout << "interval: " << certified.first << " points, " << certified.second << "s"
+         << " (x" << certified.second / inexact.second << ", "
+         << interval_statistics.fallbacks << "/" << interval_statistics.evaluations << " exact fallbacks)" << endl;
+    cout << "exact:    " << exact.first << " points, " << exact.second << "s"
+         << " (x" << exact.second / inexact.second << ")" << endl;
+}
+
+// random walks with their vertices on a grid of step 1 / grid, each
+// heading drift per step in a direction of its own
+vector<vector<Point>> random_polylines(size_t num_polylines, size_t num_vertices, double grid, double drift = 0)
+{
+    auto g = default_random_engine(num_polylines * num_vertices);
+    auto step = normal_distribution<double>(0, 1);
+    auto angle = uniform_real_distribution<double>(0, 2 * M_PI);
+    auto polylines = vector<vector<Point>>(num_polylines);
+    for (auto &polyline : polylines)
     {
-        return vertically_less(a, b) ? a : b;
+        auto p = Point(2 * step(g), 2 * step(g));
+        auto a = drift > 0 ? angle(g) : 0;
+        auto heading = Point(cos(a), sin(a)) * drift;
+        for (size_t i = 0; i < num_vertices; ++i)
+        {
+            p = p + Point(step(g), step(g)) * 0.05 + heading;
+            polyline.push_back({round(p.x * grid) / grid, round(p.y * grid) / grid});
+        }
     }
+    return polylines;
+}
 
-    Point just_below(const Point &p) const
+// The polylines swept as plain segments by the kernels that order the
+// status against exact or certified intersection points; the grid is a
+// power of two so that every kernel sees the same input. The double and
+// filtered kernels are left out, their rounded intersection points can
+// lose a segment on such input.
+bool degenerate(size_t num_polylines, size_t num_vertices)
+{
+    const double grid = 1024;
+    auto segments = vector<Segment<DoubleKernel>>();
+    for (const auto &polyline : random_polylines(num_polylines, num_vertices, grid))
     {
-        auto v = normal(lower_endpoint() - upper_endpoint());
-        return p + v;
+        for (size_t i = 0; i + 1 < polyline.size(); ++i)
+        {
+            segments.push_back({polyline[i], polyline[i + 1]});
+        }
     }
+    auto interval_segments = convert<IntervalKernel>(segments, 1);
+    auto exact_segments = convert<ExactKernel>(segments, grid);
+
+    auto certified = timed([&]() { return count_intersections(interval_segments); });
+    auto exact = timed([&]() { return count_intersections(exact_segments); });
+    cout << "segments: " << segments.size() << " on a grid of 1/" << grid << endl;
+    cout << "interval: " << certified.first << " points, " << certified.second << "s" << endl;
+    cout << "exact:    " << exact.first << " points, " << exact.second << "s" << endl;
+    cout << (certified.first == exact.first ? "same points" : "different points") << endl;
+    return certified.first == exact.first;
+}
 
-    vector2<double> direction() const
+// The polylines read back from a WKT file, which links their monotone
+// chains, and swept with and without them by the exact kernel, scaled onto
+// its grid as in degenerate.
+bool chains(size_t num_polylines, size_t num_vertices)
+{
+    const double grid = 1024;
+    auto path = filesystem::temp_directory_path().string() + "/polylines.wkt";
     {
-        return b - a;
+        auto output = ofstream(path);
+        output.precision(17);
+        for (const auto &polyline : random_polylines(num_polylines, num_vertices, grid, 0.1))
+        {
+            output << "LINESTRING (";
+            for (size_t i = 0; i < polyline.size(); ++i)
+            {
+                output << (i > 0 ? ", " : "") << polyline[i].x * grid << " " << polyline[i].y * grid;
+            }
+            output << ")\n";
+        }
     }
-};
+    auto chained = read_segments<ExactKernel>(path);
+    filesystem::remove(path);
+    auto plain = chained;
+    size_t links = 0;
+    for (auto &segment : plain)
+    {
+        links += segment.next != size_t(-1);
+        segment.next = size_t(-1);
+    }
+
+    auto unchained = timed([&]() { return count_intersections(plain); });
+    auto linked = timed([&]() { return count_intersections(chained); });
+    cout << "segments: " << chained.size() << ", " << chained.size() - links << " monotone chains" << endl;
+    cout << "segments: " << unchained.first << " points, " << unchained.second << "s" << endl;
+    cout << "chains:   " << linked.first << " points, " << linked.second << "s" << endl;
+    cout << (linked.first == unchained.first ? "same points" : "different points") << endl;
+    return linked.first == unchained.first;
+}
 
-shared_ptr<Point> intersection(const Segment &s1, const Segment &s2)
+// Two segments crossing in pixel (2, 2) and a third passing through the
+// pixel of an end of the second, at two pixel sizes. The fragment of the
+// second from (2, 2) to (4, 0) is rerouted again, through the corner of
+// the hot pixel (3, 0) of the third.
+void check_snap_rounding()
 {
-    auto left = [](const Point &p, const Segment &s) {
-        return cross(s.direction(), s.a - p) < 0;
-    };
+    for (auto pixel_size : {1.0, 0.5})
+    {
+        auto segments = vector<Segment<FilteredKernel>>();
+        for (auto ends : {pair(Point(0.1, 0.2), Point(4.2, 4.1)), pair(Point(0.2, 3.9), Point(3.8, 0.3)),
+                          pair(Point(3.3, -0.4), Point(4.6, 0.45))})
+        {
+            segments.push_back({ends.first * pixel_size, ends.second * pixel_size});
+        }
+        auto expected = vector<vector<GridPoint>>{{GridPoint(0, 0), GridPoint(2, 2), GridPoint(4, 4)},
+                                                  {GridPoint(0, 4), GridPoint(2, 2), GridPoint(3, 0), GridPoint(4, 0)},
+                                                  {GridPoint(3, 0), GridPoint(4, 0), GridPoint(5, 0)}};
+        assert(snap_round(segments, pixel_size) == expected);
+    }
+}
 
-    auto ptr = shared_ptr<Point>(nullptr);
+void snap(size_t num_segments, double pixel_size)
+{
+    check_snap_rounding();
+    auto segments = convert<FilteredKernel>(random_segments(num_segments), 1);
+    auto polylines = snap_round(segments, pixel_size);
 
-    if (left(s1.a, s2) != left(s1.b, s2) && left(s2.a, s1) != left(s2.b, s1))
+    size_t num_vertices = 0;
+    for (const auto &polyline : polylines)
     {
-        auto intersection = [](const Point &a, const Point &b, const Point &c, const Point &d) {
-            auto x_diff = vector2<double>(a.x - b.x, c.x - d.x);
-            auto y_diff = vector2<double>(a.y - b.y, c.y - d.y);
-            double det = cross(x_diff, y_diff);
-            auto cr = Point(cross(a, b), cross(c, d));
-            auto e = Point(cross(cr, x_diff) / det, cross(cr, y_diff) / det);
-            return e;
-        };
-        ptr = make_shared<Point>(intersection(s1.a, s1.b, s2.a, s2.b));
+        num_vertices += polyline.size();
     }
+    cout << "segments: " << num_segments << ", pixel size: " << pixel_size
+         << ", snapped vertices: " << num_vertices << endl;
 
-    return ptr;
+    pout << ln_color("green") << segments;
+    for (const auto &polyline : polylines)
+    {
+        pout << ln_color("red") << beg_ln;
+        for (const auto &pixel : polyline)
+        {
+            pout << Point(pixel.x * pixel_size, pixel.y * pixel_size);
+        }
+        pout << end_ln;
+    }
+    pout << show << clear;
 }
 
-Point random_point()
+void node(size_t num_segments)
 {
-    auto generate = []() {
-        static random_device rd;
-        static default_random_engine g(rd());
-        static normal_distribution<double> dist(0, 1);
-        return dist(g);
+    using Kernel = FilteredKernel;
+
+    auto segments = convert<Kernel>(random_segments(num_segments), 1);
+    auto noding = node(segments);
+    cout << "segments: " << num_segments << ", split points: " << noding.points.size()
+         << ", sub segments: " << noding.points.size() + num_segments << endl;
+
+    pout << pt_color("black");
+    for (const auto &point : noding.points)
+    {
+        pout << point;
+    }
+    for (size_t id = 0; id < segments.size(); ++id)
+    {
+        // alternate colors so that the pieces can be told apart
+        size_t piece = 0;
+        noding.for_each_sub_segment(segments[id], id, [&](const auto &from, const auto &to) {
+            pout << ln_color(piece++ % 2 ? "red" : "blue") << beg_ln << from << to << end_ln;
+        });
+    }
+    pout << show << clear;
+}
+
+// A square with a square hole, a segment loose in the ring between them
+// and a square outside, counterclockwise: the forward half-edges of a
+// square have its inside on their left, the backward ones the outside.
+template <class Kernel>
+void check_faces(const Dcel<Kernel> &dcel)
+{
+    auto face = [&dcel](size_t id, bool forward) {
+        for (const auto &h : dcel.half_edges)
+        {
+            if (h.segment == id && h.forward == forward)
+            {
+                return h.face;
+            }
+        }
+        return Dcel<Kernel>::none;
     };
-    return {generate(), generate()};
+    assert(dcel.num_faces == 4);
+    auto ring = face(0, true), hole = face(4, true), outside = face(9, true);
+    assert(ring != 0 && hole != 0 && outside != 0 && ring != hole && hole != outside && outside != ring);
+    for (size_t id = 0; id < 4; ++id)
+    {
+        assert(face(id, true) == ring && face(id, false) == 0);
+        assert(face(4 + id, true) == hole && face(4 + id, false) == ring);
+        assert(face(9 + id, true) == outside && face(9 + id, false) == 0);
+    }
+    assert(face(8, true) == ring && face(8, false) == ring);
 }
 
-Segment random_segment()
+template <class Kernel>
+void check_faces()
 {
-    return {random_point(), random_point()};
+    auto segments = vector<Segment<Kernel>>();
+    auto square = [&segments](double x, double y, double size) {
+        auto corners = {Point(x, y), Point(x + size, y), Point(x + size, y + size), Point(x, y + size)};
+        auto corner = corners.begin();
+        for (size_t i = 0; i < 4; ++i)
+        {
+            segments.push_back({Kernel::from_double(corner[i]), Kernel::from_double(corner[(i + 1) % 4])});
+        }
+    };
+    // integers, for ExactKernel
+    square(0, 0, 16);
+    square(4, 4, 8);
+    segments.push_back({Kernel::from_double(Point(2, 2)), Kernel::from_double(Point(3, 14))});
+    square(20, 0, 4);
+    check_faces(build_dcel(segments));
+    check_faces(build_dcel(segments, node(segments)));
 }
 
-Plotter &operator<<(Plotter &out, const Point &point)
+// Euler's formula, V - E + F = 1 + C for C connected components
+template <class Kernel>
+bool euler(const Dcel<Kernel> &dcel)
 {
-    out << new_pt(point.x, point.y);
-    return out;
+    auto parent = vector<size_t>(dcel.vertices.size());
+    iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](size_t v) {
+        while (parent[v] != v)
+        {
+            v = parent[v] = parent[parent[v]];
+        }
+        return v;
+    };
+    size_t components = dcel.vertices.size();
+    for (size_t h = 0; h < dcel.half_edges.size(); h += 2)
+    {
+        auto u = find(dcel.half_edges[h].origin), v = find(dcel.destination(h));
+        components -= u != v;
+        parent[u] = v;
+    }
+    return dcel.vertices.size() + dcel.num_faces == dcel.half_edges.size() / 2 + 1 + components;
 }
 
-Plotter &operator<<(Plotter &out, const Segment &segment)
+bool arrangement(size_t num_segments)
 {
-    out << beg_ln << segment.a << segment.b << end_ln;
-    return out;
+    using Kernel = FilteredKernel;
+
+    check_faces<Kernel>();
+    check_faces<ExactKernel>();
+
+    auto segments = convert<Kernel>(random_segments(num_segments), 1);
+    auto swept = timed([&]() { return build_dcel(segments); });
+    auto separate = timed([&]() { return build_dcel(segments, node(segments)); });
+
+    auto report = [](const Dcel<Kernel> &dcel) {
+        cout << dcel.vertices.size() << " vertices, " << dcel.half_edges.size() / 2 << " edges, " << dcel.num_faces
+             << " faces";
+    };
+    cout << "segments: " << num_segments << endl;
+    cout << "during the sweep: ";
+    report(swept.first);
+    cout << ", " << swept.second << "s" << endl;
+    cout << "from noding:      ";
+    report(separate.first);
+    cout << ", " << separate.second << "s (x" << separate.second / swept.second << ")" << endl;
+
+    auto valid = euler(swept.first) && euler(separate.first) && swept.first.num_faces == separate.first.num_faces;
+    cout << (valid ? "faces agree with Euler's formula" : "faces disagree with Euler's formula") << endl;
+    return valid;
 }
 
-Plotter &operator<<(Plotter &out, const vector<Segment> &segments)
+// The known areas of square with square, and of a square with a hole
+// with a rectangle over half of the hole, for every operation; the signed
+// areas of the rings add up to the area of the result.
+template <class Kernel>
+void check_boolean()
 {
-    for (const auto &segment : segments)
+    auto ring = [](double x0, double y0, double x1, double y1) {
+        auto corners = {Point(x0, y0), Point(x1, y0), Point(x1, y1), Point(x0, y1)};
+        auto ring = Ring<Kernel>();
+        for (const auto &p : corners)
+        {
+            ring.push_back(Kernel::from_double(p));
+        }
+        return ring;
+    };
+    auto clockwise = [](Ring<Kernel> ring) {
+        reverse(ring.begin(), ring.end());
+        return ring;
+    };
+    auto area = [](const vector<Ring<Kernel>> &subject, const vector<Ring<Kernel>> &clip, BooleanOperation operation) {
+        double area = 0;
+        for (const auto &ring : boolean_operation<Kernel>(subject, clip, operation))
+        {
+            for (size_t i = 0; i < ring.size(); ++i)
+            {
+                auto p = Kernel::to_double(ring[i]), q = Kernel::to_double(ring[(i + 1) % ring.size()]);
+                area += (p.x * q.y - q.x * p.y) / 2;
+            }
+        }
+        return area;
+    };
+    using Op = BooleanOperation;
+
+    auto square = vector<Ring<Kernel>>{ring(0, 0, 2, 2)}, other = vector<Ring<Kernel>>{ring(1, 1, 3, 3)};
+    assert(area(square, other, Op::union_) == 7);
+    assert(area(square, other, Op::intersection) == 1);
+    assert(area(square, other, Op::difference) == 3);
+    assert(area(square, other, Op::symmetric_difference) == 6);
+
+    auto holed = vector<Ring<Kernel>>{ring(0, 0, 4, 4), clockwise(ring(1, 1, 3, 3))};
+    auto rectangle = vector<Ring<Kernel>>{ring(2, 1, 5, 3)};
+    assert(area(holed, rectangle, Op::union_) == 16);
+    assert(area(holed, rectangle, Op::intersection) == 2);
+    assert(area(holed, rectangle, Op::difference) == 10);
+    assert(area(holed, rectangle, Op::symmetric_difference) == 14);
+    assert(area(rectangle, holed, Op::difference) == 4);
+}
+
+void overlay(size_t num_vertices, const string &name)
+{
+    using Kernel = FilteredKernel;
+
+    auto operation = name == "intersection" ? BooleanOperation::intersection
+                   : name == "difference"   ? BooleanOperation::difference
+                   : name == "xor"          ? BooleanOperation::symmetric_difference
+                                            : BooleanOperation::union_;
+    check_boolean<Kernel>();
+    check_boolean<ExactKernel>();
+
+    // two polygons with a hole each
+    auto polygon = [num_vertices]() {
+        auto outer = random_ring(num_vertices);
+        auto center = Point(0, 0);
+        for (const auto &p : outer)
+        {
+            center = center + p / double(outer.size());
+        }
+        auto hole = vector<Point>(outer.rbegin(), outer.rend());
+        for (auto &p : hole)
+        {
+            p = center + (p - center) * 0.3;
+        }
+        return vector<Ring<Kernel>>{outer, hole};
+    };
+    auto subject = polygon();
+    auto clip = polygon();
+
+    auto rings = timed([&]() { return boolean_operation<Kernel>(subject, clip, operation); });
+    cout << "vertices: " << 4 * num_vertices << ", rings: " << rings.first.size() << ", " << rings.second << "s"
+         << endl;
+
+    auto draw = [](const vector<Point> &ring) {
+        pout << beg_ln;
+        for (const auto &p : ring)
+        {
+            pout << p;
+        }
+        pout << ring.front() << end_ln;
+    };
+    pout << ln_color("green");
+    for (const auto &ring : subject)
     {
-        out << segment;
+        draw(ring);
     }
-    return out;
+    pout << ln_color("blue");
+    for (const auto &ring : clip)
+    {
+        draw(ring);
+    }
+    pout << ln_color("red");
+    for (const auto &ring : rings.first)
+    {
+        draw(ring);
+    }
+    pout << show << clear;
 }
 
-void sweep_line(const vector<Segment> &segments)
+void validate(size_t num_rings, size_t num_vertices)
 {
-    struct Event
+    using Kernel = FilteredKernel;
+
+    // star shaped rings are simple, every other one is shuffled
+    static default_random_engine g(random_device{}());
+    auto rings = vector<Ring<Kernel>>();
+    rings.reserve(num_rings);
+    for (size_t i = 0; i < num_rings; ++i)
     {
-        enum class Type
+        auto ring = random_ring(num_vertices);
+        if (i % 2)
         {
-            upper,
-            lower,
-            intersection,
-        };
-        Point point;
-        Type type;
-        Segment segment;
-    };
+            shuffle(ring.begin(), ring.end(), g);
+        }
+        rings.push_back(ring);
+    }
 
-    auto events = [&segments]() {
-        // initialize Q
-        auto v_less = [](const Event &a,
-                         const Event &b) {
-            return vertically_less(a.point, b.point);
-        };
+    auto simple = timed([&]() { return validate_rings<Kernel>(rings); });
+    cout << "rings: " << num_rings << ", simple: " << count(simple.first.begin(), simple.first.end(), 1) << ", "
+         << simple.second << "s" << endl;
+}
 
-        auto events = multiset<Event,
-                               decltype(v_less)>(v_less);
+bool manhattan(size_t num_segments)
+{
+    using Kernel = FilteredKernel;
 
-        for (auto segment : segments)
+    // half horizontal, half vertical
+    auto segments = vector<Segment<Kernel>>();
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        auto a = random_point();
+        auto length = random_point().x;
+        segments.push_back({a, i % 2 ? a + Point(0, length) : a + Point(length, 0)});
+    }
+    assert(is_orthogonal(segments));
+
+    auto general = timed([&]() { return count_intersections(segments); });
+    auto counted = timed([&]() { return count_orthogonal_intersections(segments); });
+    auto reported = timed([&]() {
+        size_t count = 0;
+        orthogonal_intersections(segments, [&count](size_t, size_t) { ++count; });
+        return count;
+    });
+
+    // the dispatch, and sweep_line once a far diagonal makes the input
+    // general
+    auto dispatched = timed([&]() { return count_intersecting_pairs(segments); });
+    segments.push_back({Point(1000, 1000), Point(1001, 1001)});
+    auto swept = timed([&]() { return count_intersecting_pairs(segments); });
+
+    cout << "segments: " << num_segments << endl;
+    cout << "sweep:    " << general.first << " points, " << general.second << "s" << endl;
+    cout << "report:   " << reported.first << " pairs, " << reported.second << "s" << endl;
+    cout << "count:    " << counted.first << " pairs, " << counted.second << "s" << endl;
+    cout << "dispatch: " << dispatched.first << " pairs, " << dispatched.second << "s, general "
+         << swept.first << " pairs, " << swept.second << "s" << endl;
+    auto same = reported.first == counted.first && dispatched.first == counted.first && swept.first == counted.first;
+    cout << (same ? "same pairs" : "different pairs") << endl;
+    return same;
+}
+
+void boxes(size_t num_segments)
+{
+    using Kernel = FilteredKernel;
+
+    // short segments spread out, as in map data
+    auto segments = vector<Segment<Kernel>>();
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        auto a = random_point() * 10;
+        segments.push_back({a, a + random_point() * 0.1});
+    }
+
+    auto swept = timed([&]() { return count_intersections(segments); });
+    auto candidates = atomic<size_t>(0);
+    auto pruned = timed([&]() {
+        auto crossings = atomic<size_t>(0);
+        overlapping_boxes(segments, [&](const vector<pair<size_t, size_t>> &block) {
+            auto found = vector<Crossing<Kernel>>();
+            intersections(segments, block, found);
+            candidates += block.size();
+            crossings += found.size();
+        });
+        return crossings.load();
+    });
+
+    cout << "segments: " << num_segments << endl;
+    cout << "sweep:            " << swept.first << " points, " << swept.second << "s" << endl;
+    cout << "sweep and prune:  " << pruned.first << " crossings of " << candidates << " candidates, "
+         << pruned.second << "s" << endl;
+}
+
+void clearance(size_t num_segments, double epsilon)
+{
+    using Kernel = FilteredKernel;
+
+    // short segments spread out, as in boxes
+    auto segments = vector<Segment<Kernel>>();
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        auto a = random_point() * 10;
+        segments.push_back({a, a + random_point() * 0.1});
+    }
+
+    auto pairs = atomic<size_t>(0);
+    auto seconds = timed([&]() {
+        box_pruned_close_pairs(segments, epsilon,
+                               [&](const vector<pair<size_t, size_t>> &block) { pairs += block.size(); });
+    });
+    cout << "segments: " << num_segments << ", pairs within " << epsilon << ": " << pairs << ", " << seconds << "s"
+         << endl;
+}
+
+// text files by extension, segment files otherwise
+bool text_file(const string &path)
+{
+    for (string extension : {".csv", ".wkt", ".geojson", ".json"})
+    {
+        if (path.size() >= extension.size() &&
+            path.compare(path.size() - extension.size(), extension.size(), extension) == 0)
         {
-            segment.key = segment.upper_endpoint();
+            return true;
+        }
+    }
+    return false;
+}
 
-            events.insert({
-                segment.upper_endpoint(),
-                Event::Type::upper,
-                segment,
-            });
+void write_text(const string &path, const vector<Segment<DoubleKernel>> &segments)
+{
+    auto output = ofstream(path);
+    output.precision(17);
+    auto format = text_format(path);
+    if (format == TextFormat::geojson)
+    {
+        output << "{\"type\": \"FeatureCollection\", \"features\": [\n";
+    }
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        const auto &a = segments[i].a, &b = segments[i].b;
+        if (format == TextFormat::csv)
+        {
+            output << a.x << "," << a.y << "," << b.x << "," << b.y << "," << i << "\n";
+        }
+        else if (format == TextFormat::wkt)
+        {
+            output << "LINESTRING (" << a.x << " " << a.y << ", " << b.x << " " << b.y << ")\n";
+        }
+        else
+        {
+            output << (i > 0 ? ",\n" : "") << "{\"type\": \"Feature\", \"properties\": {\"id\": " << i
+                   << "}, \"geometry\": {\"type\": \"LineString\", \"coordinates\": [[" << a.x << ", " << a.y
+                   << "], [" << b.x << ", " << b.y << "]]}}";
+        }
+    }
+    if (format == TextFormat::geojson)
+    {
+        output << "\n]}\n";
+    }
+}
 
-            events.insert({
-                segment.lower_endpoint(),
-                Event::Type::lower,
-                segment,
-            });
+void save(size_t num_segments, const string &path, double quantum)
+{
+    auto segments = random_segments(num_segments);
+    if (text_file(path))
+    {
+        write_text(path, segments);
+    }
+    else
+    {
+        auto ids = vector<uint64_t>(num_segments);
+        iota(ids.begin(), ids.end(), 0);
+        write_segment_file(path, segments, ids, quantum);
+    }
+    cout << "segments: " << num_segments << " written to " << path << endl;
+}
+
+void load_file(const string &path)
+{
+    if (text_file(path))
+    {
+        auto segments = timed([&]() { return read_segments<FilteredKernel>(path); });
+        cout << "segments: " << segments.first.size() << ", parsed in " << segments.second << "s" << endl;
+        auto points = timed([&]() { return count_intersections(segments.first); });
+        cout << "sweep: " << points.first << " points, " << points.second << "s" << endl;
+        return;
+    }
+
+    auto file = unique_ptr<MappedSegments>();
+    auto mapped = timed([&]() { file = make_unique<MappedSegments>(path); });
+
+    // touch every record in place
+    double xlo = INFINITY, xhi = -INFINITY;
+    auto scanned = timed([&]() {
+        for (const auto &r : file->doubles())
+        {
+            xlo = min({xlo, r.ax, r.bx});
+            xhi = max({xhi, r.ax, r.bx});
+        }
+        for (const auto &r : file->grid())
+        {
+            xlo = min({xlo, file->header().x0 + file->header().scale * min(r.ax, r.bx)});
+            xhi = max({xhi, file->header().x0 + file->header().scale * max(r.ax, r.bx)});
         }
+    });
+    cout << "segments: " << file->size() << (file->quantized() ? " quantized" : "")
+         << (file->ids().empty() ? "" : " with ids") << ", x in [" << xlo << ", " << xhi << "], mapped in " << mapped
+         << "s, scanned in " << scanned << "s" << endl;
+
+    auto points = timed([&]() { return count_intersections(MappedSegmentsView<FilteredKernel>{file.get()}); });
+    cout << "sweep: " << points.first << " points, " << points.second << "s" << endl;
+}
+
+// false if the file cannot be read, e.g. a text line that does not parse
+bool load(const string &path)
+{
+    try
+    {
+        load_file(path);
+        return true;
+    }
+    catch (const exception &e)
+    {
+        cerr << "load: " << e.what() << endl;
+        return false;
+    }
+}
 
-        return events;
-    }(); // multiset
+// random segments on a grid of 2^30, their crossings growing linearly with
+// crossings, written as they are drawn so that the file can be larger than
+// memory
+void generate_segments(const string &path, size_t num_segments, double crossings = 1)
+{
+    auto g = default_random_engine(num_segments);
+    double size = 1 << 30, length = min(size / 2, size * sqrt(crossings / num_segments));
+    auto coordinate = uniform_real_distribution<double>(0, size - length);
+    auto offset = uniform_real_distribution<double>(0, length);
+    auto writer = SegmentFileWriter(path, 1);
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        auto a = Point(round(coordinate(g)), round(coordinate(g)));
+        writer.add(a, a + Point(round(offset(g)), round(offset(g))));
+    }
+    writer.finish();
+}
+
+// A queue of two events in memory: an intersection event queued again
+// once it is on disk is kept twice, as insert_once allows, and everything
+// comes back in sweep order. Then 20 lines up and 20 down, crossing each
+// other once, swept within 1 KB, which spills: each crossing comes once,
+// with its two segments.
+void check_spilled_events()
+{
+    using Kernel = FilteredKernel;
+    using Event = ::Event<Kernel>;
+
+    io_statistics() = {};
+    auto event = [](double y) {
+        auto segment = Segment<Kernel>{Point(0, y + 1), Point(0, y - 1)};
+        segment.id = size_t(y);
+        return Event{Point(0, y), Event::Type::intersection, segment};
+    };
+    auto queue = SpillingEventQueue<Kernel>(0);
+    for (auto y = 1; y <= 8; ++y)
+    {
+        queue.insert_once(event(y));
+    }
+    assert(io_statistics().spilled > 0);
+    queue.insert_once(event(1));
+    auto ids = vector<size_t>();
+    for (; !queue.empty(); queue.pop())
+    {
+        ids.push_back(queue.top().segment.id);
+    }
+    assert((ids == vector<size_t>{8, 7, 6, 5, 4, 3, 2, 1, 1}));
 
-    auto status = []() {
-        auto cmp = [](const Segment &s1, const Segment &s2) {
-            if (s1.key.x == s2.key.x)
+    auto lattice = vector<Segment<Kernel>>();
+    for (auto k = 1; k <= 20; ++k)
+    {
+        lattice.push_back({Point(-60, 2 * k + 0.5 - 60), Point(60, 2 * k + 0.5 + 60)});
+        lattice.push_back({Point(-60, 2 * k + 60), Point(60, 2 * k - 60)});
+    }
+    io_statistics() = {};
+    size_t crossings = 0;
+    auto in_order = true;
+    auto last = Point(0, 1000);
+    external_sweep_line(
+        lattice,
+        [&](const auto &point, const auto &events, const auto &) {
+            in_order = in_order && Kernel::vertically_less(point, last);
+            last = point;
+            if (abs(point.x) < 60)
             {
-                auto p = s1.key;
-                return s1.just_below(p).x < s2.just_below(p).x;
+                assert(events.size() == 2);
+                ++crossings;
             }
-            return s1.key.x < s2.key.x;
-        };
-        return set<Segment, decltype(cmp)>(cmp);
-    }(); // set
-
-    while (events.size())
-    {
-        const auto events_at_next_point = [&events]() {
-            auto result_events = vector<Event>();
-            auto point = events.rbegin()->point;
-            // there may be more than 1 event at this point
-            while (events.size() > 0 &&
-                   events.rbegin()->point == point)
+        },
+        1 << 10);
+    assert(io_statistics().spilled > 0 && crossings == 400 && in_order);
+}
+
+void out_of_core(size_t num_segments, double memory_mb, double crossings)
+{
+    check_spilled_events();
+
+    auto path = filesystem::temp_directory_path().string() + "/external_segments.bin";
+    generate_segments(path, num_segments, crossings);
+    auto file = MappedSegments(path);
+    auto segments = MappedSegmentsView<FilteredKernel>{&file};
+    auto events = 2 * num_segments * sizeof(ExternalEndpoints<decltype(segments)>::Record);
+    cout << "segments: " << num_segments << ", endpoint events: " << events / 1e6 << " MB, budget: " << memory_mb
+         << " MB" << endl;
+
+    io_statistics() = {};
+    size_t points = 0;
+    auto seconds = timed([&]() {
+        external_sweep_line(
+            segments, [&points](const auto &, const auto &events, const auto &) { points += events.size() > 1; },
+            size_t(memory_mb * (1 << 20)));
+    });
+    const auto &io = io_statistics();
+    cout << "external:  " << points << " points, " << io.writes << " writes (" << io.bytes_written / 1e6 << " MB), "
+         << io.reads << " reads (" << io.bytes_read / 1e6 << " MB, " << io.bytes_read / 1e3 / max<size_t>(1, io.reads)
+         << " KB each), " << seconds << "s" << endl;
+    cout << "events spilled: " << io.spilled / 1e6 << " MB, reloaded: " << io.reloaded / 1e6 << " MB" << endl;
+
+    auto in_memory = timed([&]() { return count_intersections(segments); });
+    cout << "in memory: " << in_memory.first << " points, " << in_memory.second << "s" << endl;
+    filesystem::remove(path);
+}
+
+// the file must have the pairs of the in-memory sweep, in sweep order
+bool tiled(size_t num_segments, size_t tiles, double crossings)
+{
+    auto directory = filesystem::temp_directory_path().string();
+    auto path = directory + "/tiled_segments.bin", output = directory + "/intersections.bin";
+    generate_segments(path, num_segments, crossings);
+    auto file = MappedSegments(path);
+    auto segments = MappedSegmentsView<FilteredKernel>{&file};
+    cout << "segments: " << num_segments << ", tiles: " << tiles << "x" << tiles << endl;
+
+    auto grid = tile_grid(segments, tiles, tiles);
+    auto records = timed([&]() { return write_tiled_intersections(segments, grid, output); });
+    cout << "tiled:     " << records.first << " pairs, " << filesystem::file_size(output) / 1e6 << " MB written, "
+         << records.second << "s" << endl;
+    auto in_order = true;
+    auto last = vector2<double>(0, 0);
+    size_t k = 0;
+    for (const auto &r : IntersectionFile(output))
+    {
+        in_order = in_order && (k++ == 0 || !FilteredKernel::vertically_less(last, r.point));
+        last = r.point;
+    }
+
+    size_t pairs = 0;
+    auto ids = vector<size_t>();
+    auto seconds = timed([&]() {
+        sweep_line(segments, [&](const auto &, const auto &events, const auto &) {
+            meeting_pairs(events, ids, [&pairs](size_t, size_t) { ++pairs; });
+        });
+    });
+    cout << "in memory: " << pairs << " pairs, " << seconds << "s" << endl;
+    filesystem::remove(path);
+    filesystem::remove(output);
+
+    auto same = records.first == pairs;
+    cout << (same ? "same pairs" : "different pairs") << (in_order ? ", in sweep order" : ", out of order") << endl;
+    return same && in_order;
+}
+
+// Segments of which segment `failing` fails in the forked workers, by an
+// exception or by killing the worker; the parent reads them all.
+struct FailingSegments
+{
+    vector<Segment<FilteredKernel>> segments;
+    size_t failing;
+    bool killed;
+    pid_t parent = ::getpid();
+
+    size_t size() const
+    {
+        return segments.size();
+    }
+
+    const Segment<FilteredKernel> &operator[](size_t i) const
+    {
+        if (i == failing && ::getpid() != parent)
+        {
+            if (killed)
             {
-                auto event = *events.rbegin();
-                result_events.push_back(event);
-                events.erase(prev(events.end())); // i.e. erase rbegin
+                ::kill(::getpid(), SIGKILL);
             }
-            return result_events;
-        }();
+            throw runtime_error("failing segment");
+        }
+        return segments[i];
+    }
+};
 
-        // report event point
-        static auto reported_points = vector<Point>();
+// A crossing in each of two slabs, the bottom one failing: the worker of
+// the bottom slab is reported and no worker is left behind.
+void check_shard_failures()
+{
+    auto segments = vector<Segment<FilteredKernel>>{{Point(0, 0), Point(1, 1)},
+                                                    {Point(0, 1), Point(1, 0)},
+                                                    {Point(0, 9), Point(1, 10)},
+                                                    {Point(0, 10), Point(1, 9)}};
+    size_t records = 0;
+    sharded_intersections(FailingSegments{segments, size_t(-1), false}, 2, [&records](const auto &) { ++records; });
+    assert(records == 2);
+    for (auto killed : {false, true})
+    {
+        auto message = string();
+        try
+        {
+            sharded_intersections(FailingSegments{segments, 0, killed}, 2, [](const auto &) {});
+        }
+        catch (const runtime_error &e)
         {
-            reported_points.push_back(events_at_next_point.front().point);
+            message = e.what();
         }
+        assert(message == "worker 0 failed");
+        assert(::waitpid(-1, nullptr, WNOHANG) == -1 && errno == ECHILD);
+    }
+}
 
-        const auto event_filter = [&events_at_next_point](Event::Type type) {
-            auto result_events = vector<Event>();
-            for (const auto &event : events_at_next_point)
+// The processes once with the default rings and once with rings of
+// ring_size records, smaller than the output of every slab, against the
+// threads; the records must come in sweep order.
+bool sharded(size_t num_segments, size_t num_workers, double crossings, size_t ring_size)
+{
+    check_shard_failures();
+
+    auto path = filesystem::temp_directory_path().string() + "/sharded_segments.bin";
+    generate_segments(path, num_segments, crossings);
+    auto file = MappedSegments(path);
+    auto segments = MappedSegmentsView<FilteredKernel>{&file};
+    cout << "segments: " << num_segments << ", workers: " << num_workers << endl;
+
+    auto in_order = true;
+    auto count = [&](size_t ring_size) {
+        size_t records = 0;
+        auto last = FilteredKernel::EventPoint();
+        sharded_intersections(
+            segments, num_workers,
+            [&](const auto &record) {
+                in_order = in_order && (records == 0 || !FilteredKernel::vertically_less(last, record.point));
+                last = record.point;
+                ++records;
+            },
+            ring_size);
+        return records;
+    };
+    auto processes = timed([&]() { return count(1 << 16); });
+    cout << "processes: " << processes.first << " pairs, " << processes.second << "s" << endl;
+    auto small = timed([&]() { return count(ring_size); });
+    cout << "rings of " << ring_size << ": " << small.first << " pairs, " << small.second << "s" << endl;
+
+    auto threads = timed([&]() {
+        // strips side by side, the rows of tiles being swept one at a time
+        size_t slab_records = 0;
+        tiled_intersections(segments, tile_grid(segments, num_workers, 1),
+                            [&slab_records](size_t, const auto &records) { slab_records += records.size(); });
+        return slab_records;
+    });
+    cout << "threads:   " << threads.first << " pairs, " << threads.second << "s" << endl;
+    filesystem::remove(path);
+
+    auto same = processes.first == threads.first && small.first == threads.first;
+    cout << (same ? "same pairs" : "different pairs") << (in_order ? ", in sweep order" : ", out of order") << endl;
+    return same && in_order;
+}
+
+// Records going both ways in x, y and the ids, with extreme ones, through
+// every format and back; the buffer of 16 bytes is flushed at every record.
+void check_intersection_file(const string &path)
+{
+    auto records = vector<intersection_file::Record>{
+        {Point(1.5, 1e300), 0, 1},
+        {Point(-0.0, 2.5), 7, 3},
+        {Point(-1e-300, 2.5), uint64_t(-1), 2},
+        {Point(numeric_limits<double>::infinity(), -3), 5, uint64_t(1) << 63},
+        {Point(0.25, -numeric_limits<double>::infinity()), 4, 4},
+    };
+    for (auto delta : {false, true})
+    {
+        auto writer = IntersectionFileWriter(path, delta, 0, 0, 0, 16);
+        for (const auto &r : records)
+        {
+            writer.add(r.point, r.i, r.j);
+        }
+        writer.finish();
+        size_t k = 0;
+        for (const auto &r : IntersectionFile(path))
+        {
+            const auto &w = records[k++];
+            assert(r.i == w.i && r.j == w.j && r.point == w.point && signbit(r.point.x) == signbit(w.point.x));
+        }
+        assert(k == records.size());
+    }
+
+    // to the nearest multiple of 0.5 from (1, 1)
+    auto writer = IntersectionFileWriter(path, true, 0.5, 1, 1, 16);
+    writer.add(Point(1.2, -7.3), 9, 2);
+    writer.add(Point(100.1, 0.9), 1, 8);
+    writer.finish();
+    auto file = IntersectionFile(path);
+    auto it = file.begin();
+    assert(file.size() == 2 && (*it).point == Point(1, -7.5) && (*it).i == 9 && (*it).j == 2);
+    ++it;
+    assert((*it).point == Point(100, 1) && (*it).i == 1 && (*it).j == 8);
+    filesystem::remove(path);
+}
+
+// the intersections as text and in the binary formats, then read back
+bool write_intersections(size_t num_segments, double crossings)
+{
+    auto directory = filesystem::temp_directory_path().string();
+    check_intersection_file(directory + "/check_intersections.bin");
+    auto path = directory + "/output_segments.bin";
+    generate_segments(path, num_segments, crossings);
+    auto file = MappedSegments(path);
+    auto segments = MappedSegmentsView<FilteredKernel>{&file};
+    auto records = vector<intersection_file::Record>();
+    auto ids = vector<size_t>();
+    sweep_line(segments, [&](const auto &point, const auto &events, const auto &) {
+        meeting_pairs(events, ids, [&](size_t i, size_t j) {
+            records.push_back({FilteredKernel::to_double(point), i, j});
+        });
+    });
+    filesystem::remove(path);
+    cout << "segments: " << num_segments << ", pairs: " << records.size() << endl;
+
+    auto output = directory + "/intersections.csv";
+    auto seconds = timed([&]() {
+        auto text = ofstream(output);
+        text.precision(17);
+        for (const auto &r : records)
+        {
+            text << r.point.x << "," << r.point.y << "," << r.i << "," << r.j << "\n";
+        }
+    });
+    auto text_size = filesystem::file_size(output);
+    cout << "csv:       " << text_size / 1e6 << " MB, " << seconds << "s" << endl;
+    filesystem::remove(output);
+
+    output = directory + "/intersections.bin";
+    auto raw_size = size_t(0), all_mismatches = size_t(0);
+    auto binary = [&](const string &name, bool delta, double quantum) {
+        auto seconds = timed([&]() {
+            auto writer = IntersectionFileWriter(output, delta, quantum);
+            for (const auto &r : records)
             {
-                if (event.type == type)
-                {
-                    result_events.push_back(event);
-                }
+                writer.add(r.point, r.i, r.j);
             }
-            return result_events;
-        };
-        const auto upper_events = event_filter(Event::Type::upper);
-        const auto intersection_events = event_filter(Event::Type::intersection);
-        const auto lower_events = event_filter(Event::Type::lower);
-
-        // delete and insert/re-insert the segments into status
-        {
-            const auto remove_event_segment_from_status = [&status](const vector<Event> &events) {
-                auto erase_from_status = [&status](const auto &s1) {
-                    for (auto it = status.begin(); it != status.end(); ++it)
-                    {
-                        const auto &s2 = *it;
-                        if (s1.a == s2.a && s1.b == s2.b)
-                        {
-                            status.erase(it);
-                            return true;
-                        }
-                    }
-                    return false;
-                };
-
-                for (const auto &event : events)
-                {
-                    assert(erase_from_status(event.segment) && "erase failed!");
-                }
-            };
-
-            remove_event_segment_from_status(lower_events);
-            remove_event_segment_from_status(intersection_events);
-
-            const auto insert_event_segment_to_status = [&status](const vector<Event> &events) {
-                for (auto event : events)
-                {
-                    event.segment.key = event.point;
-                    status.insert(event.segment);
-                }
-            };
-
-            insert_event_segment_to_status(intersection_events);
-            insert_event_segment_to_status(upper_events);
-        }
-
-        // update intersection in the new status
-        {
-            const auto append_new_event = [&events](const Segment &l, const Segment &r, const Point &pt) {
-                // if the intersection point is under pt, register this event
-                auto ptr = intersection(l, r);
-                if (ptr != nullptr)
-                {
-                    auto int_pt = *ptr;
-                    if (vertically_less(int_pt, pt))
-                    {
-                        events.insert(Event{
-                            int_pt,
-                            Event::Type::intersection,
-                            l});
-
-                        events.insert(Event{
-                            int_pt,
-                            Event::Type::intersection,
-                            r});
-                    }
-                }
-            };
-            const auto key_segment = Segment{
-                Point(),
-                Point(),
-                events_at_next_point.front().point};
-            const auto lower_it = status.lower_bound(key_segment);
-            const auto upper_it = status.upper_bound(key_segment);
-            if (lower_it != status.begin() && upper_it != status.end())
+            writer.finish();
+        });
+        auto size = filesystem::file_size(output);
+        raw_size = delta ? raw_size : size;
+        size_t mismatches = 0, k = 0;
+        auto read_seconds = timed([&]() {
+            for (const auto &r : IntersectionFile(output))
             {
-                if (upper_events.size() + intersection_events.size() == 0)
-                {
-                    // only leaving segments
-                    assert(lower_it == upper_it && "all segments on this point should be left.");
-                    auto sl = *prev(lower_it);
-                    auto sr = *upper_it;
-                    append_new_event(sl, sr, key_segment.key);
-                }
-                else
-                {
-                    auto sll = *prev(lower_it);
-                    auto sl = *lower_it;
-                    append_new_event(sll, sl, key_segment.key);
-
-                    if (next(upper_it) != status.end())
-                    {
-                        auto sr = *upper_it;
-                        auto srr = *next(upper_it);
-                        append_new_event(sr, srr, key_segment.key);
-                    }
-                }
+                const auto &w = records[k++];
+                mismatches += r.i != w.i || r.j != w.j ||
+                              (quantum > 0 ? max(abs(r.point.x - w.point.x), abs(r.point.y - w.point.y)) > quantum
+                                           : !(r.point == w.point));
             }
+        });
+        cout << name << size / 1e6 << " MB (x" << double(text_size) / size << " smaller than csv, x"
+             << double(raw_size) / size << " than raw), " << seconds << "s, read in " << read_seconds << "s, "
+             << mismatches << " mismatches" << endl;
+        all_mismatches += mismatches;
+        filesystem::remove(output);
+    };
+    binary("raw:       ", false, 0);
+    binary("delta:     ", true, 0);
+    binary("quantized: ", true, 1);
+
+    // the same records with the segments numbered by their upper endpoints
+    // in sweep order, as a spatially ordered input numbers them
+    auto order = vector<size_t>(num_segments), rank = vector<size_t>(num_segments);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&segments](size_t i, size_t j) {
+        return vertically_less(input_segment(segments, j).upper_endpoint(),
+                               input_segment(segments, i).upper_endpoint());
+    });
+    for (size_t k = 0; k < num_segments; ++k)
+    {
+        rank[order[k]] = k;
+    }
+    for (auto &r : records)
+    {
+        auto i = rank[r.i], j = rank[r.j];
+        r.i = min(i, j);
+        r.j = max(i, j);
+    }
+    binary("delta, ordered ids:     ", true, 0);
+    binary("quantized, ordered ids: ", true, 1);
+    return all_mismatches == 0;
+}
+
+void graph(size_t num_segments, size_t tiles, double crossings)
+{
+    auto path = filesystem::temp_directory_path().string() + "/graph_segments.bin";
+    generate_segments(path, num_segments, crossings);
+    auto file = MappedSegments(path);
+    auto segments = MappedSegmentsView<FilteredKernel>{&file};
+    cout << "segments: " << num_segments << ", tiles: " << tiles << "x" << tiles << endl;
+
+    auto timed_csr = timed([&]() { return adjacency(segments, tiles, tiles); });
+    const auto &csr = timed_csr.first;
+    auto max_degree = size_t(0);
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        max_degree = max(max_degree, csr.degree(i));
+    }
+    cout << "csr:       " << csr.neighbors.size() << " neighbors, max degree " << max_degree << ", "
+         << (csr.offsets.size() * sizeof(csr.offsets[0]) + csr.neighbors.size() * sizeof(csr.neighbors[0])) / 1e6
+         << " MB, " << timed_csr.second << "s" << endl;
+
+    // from the flat list of pairs, both ways, by sorting
+    auto edges = vector<pair<size_t, size_t>>();
+    auto ids = vector<size_t>();
+    auto seconds = timed([&]() {
+        sweep_line(segments, [&](const auto &, const auto &events, const auto &) {
+            meeting_pairs(events, ids, [&edges](size_t i, size_t j) {
+                edges.push_back({i, j});
+                edges.push_back({j, i});
+            });
+        });
+        sort(edges.begin(), edges.end());
+        edges.erase(unique(edges.begin(), edges.end()), edges.end());
+    });
+    cout << "sorted:    " << edges.size() << " neighbors, " << seconds << "s" << endl;
+    filesystem::remove(path);
+}
+
+// Two segments crossing at (1, 1) swept online: the crossing waits for the
+// watermark to pass it, a segment starting above the watermark and a
+// watermark going up are refused without changing the sweep, and a
+// segment starting at the watermark's height is right of it, so accepted.
+void check_online_sweep()
+{
+    size_t crossings = 0;
+    auto sweep = online_sweep<FilteredKernel>([&crossings](const auto &, const auto &events, const auto &) {
+        crossings += events.size() > 1;
+    });
+    auto max = numeric_limits<double>::max();
+    sweep.push(Point(0, 2), Point(2, 0));
+    sweep.push(Point(2, 2), Point(0, 0));
+    sweep.advance(Point(max, 1.5));
+    assert(crossings == 0 && sweep.active() == 2);
+
+    auto refused = [](auto &&f, const string &message) {
+        try
+        {
+            f();
         }
+        catch (const invalid_argument &e)
+        {
+            return e.what() == message;
+        }
+        return false;
+    };
+    assert(refused([&]() { sweep.push(Point(0, 3), Point(1, 2)); }, "the segment starts above the watermark"));
+    assert(refused([&]() { sweep.advance(Point(max, 2)); }, "the watermark only goes down"));
+    assert(sweep.size() == 2);
 
-        // illustrate
+    sweep.push(Point(5, 1.5), Point(5, 0.5));
+    sweep.advance(Point(max, 0.75));
+    assert(crossings == 1);
+    sweep.finish();
+    assert(crossings == 1 && sweep.active() == 0 && sweep.size() == 3);
+}
+
+// a stream of short segments in time order, time going down the sweep,
+// swept as they come with the watermark moved every batch_size segments
+void online(size_t num_segments, size_t batch_size)
+{
+    auto g = default_random_engine(num_segments);
+    auto x = uniform_real_distribution<double>(0, 100);
+    auto offset = normal_distribution<double>(0, 1);
+    auto segments = vector<Segment<FilteredKernel>>();
+    segments.reserve(num_segments);
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+        auto a = Point(x(g), -0.01 * i);
+        segments.push_back({a, a + Point(offset(g), -abs(offset(g)))});
+    }
+    check_online_sweep();
+    cout << "segments: " << num_segments << ", batches of " << batch_size << endl;
+
+    size_t points = 0, max_active = 0;
+    auto seconds = timed([&]() {
+        auto sweep = online_sweep<FilteredKernel>([&](const auto &, const auto &events, const auto &status) {
+            points += events.size() > 1;
+            max_active = max(max_active, status.size());
+        });
+        for (size_t i = 0; i < num_segments; ++i)
         {
-            pout << pt_color("black");
-            for (auto reported_point: reported_points)
+            sweep.push(segments[i].a, segments[i].b);
+            if ((i + 1) % batch_size == 0)
             {
-                pout << reported_point;
+                // the next segments start at or below this one
+                sweep.advance(Point(numeric_limits<double>::max(), segments[i].a.y));
             }
-            pout << ln_color("green") << segments;
-            for (auto segment : status)
+        }
+        sweep.finish();
+    });
+    cout << "online:    " << points << " points, at most " << max_active << " segments on the sweep line, " << seconds
+         << "s" << endl;
+
+    auto in_memory = timed([&]() { return count_intersections(segments); });
+    cout << "in memory: " << in_memory.first << " points, " << in_memory.second << "s" << endl;
+}
+
+void coverage(size_t num_rectangles)
+{
+    auto rectangles = vector<Box<DoubleKernel>>();
+    rectangles.reserve(num_rectangles);
+    for (size_t i = 0; i < num_rectangles; ++i)
+    {
+        auto a = random_point() * 10, d = random_point();
+        rectangles.push_back({a.x, a.y, a.x + abs(d.x), a.y + abs(d.y)});
+    }
+
+    auto measure = timed([&]() { return union_measure(rectangles.begin(), rectangles.end()); });
+    cout << "rectangles: " << num_rectangles << ", area: " << measure.first.area
+         << ", perimeter: " << measure.first.perimeter << ", " << measure.second << "s" << endl;
+}
+
+void tessellate(size_t num_sites)
+{
+    auto sites = vector<Point>();
+    sites.reserve(num_sites);
+    for (size_t i = 0; i < num_sites; ++i)
+    {
+        sites.push_back(random_point());
+    }
+
+    auto diagram = timed([&]() { return voronoi_diagram<FilteredKernel>(sites); });
+    cout << "sites: " << num_sites << ", vertices: " << diagram.first.vertices.size()
+         << ", edges: " << diagram.first.edges.size() << ", " << diagram.second << "s" << endl;
+}
+
+// O(n^2) ear clipping of a counterclockwise ring, the baseline for the
+// monotone partition
+vector<uint32_t> ear_clipping(const vector<Point> &ring)
+{
+    uint32_t n = ring.size();
+    auto prev = vector<uint32_t>(n), next = vector<uint32_t>(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        prev[i] = (i + n - 1) % n;
+        next[i] = (i + 1) % n;
+    }
+    auto turn = [&ring](uint32_t a, uint32_t b, uint32_t c) {
+        return DoubleKernel::orientation(ring[a], ring[b], ring[c]);
+    };
+    auto is_ear = [&](uint32_t v) {
+        auto u = prev[v], w = next[v];
+        if (turn(u, v, w) <= 0)
+        {
+            return false;
+        }
+        for (auto p = next[w]; p != u; p = next[p])
+        {
+            if (turn(u, v, p) >= 0 && turn(v, w, p) >= 0 && turn(w, u, p) >= 0)
             {
-                pout << ln_color("red") << segment;
+                return false;
             }
-            pout << show << clear;
         }
+        return true;
+    };
+
+    auto triangles = vector<uint32_t>();
+    uint32_t v = 0;
+    for (uint32_t remaining = n, misses = 0; remaining > 3 && misses < remaining;)
+    {
+        if (!is_ear(v))
+        {
+            v = next[v];
+            ++misses;
+            continue;
+        }
+        triangles.insert(triangles.end(), {prev[v], v, next[v]});
+        next[prev[v]] = next[v];
+        prev[next[v]] = prev[v];
+        v = prev[v];
+        --remaining;
+        misses = 0;
     }
+    triangles.insert(triangles.end(), {prev[v], v, next[v]});
+    return triangles;
+}
+
+void mesh(size_t num_vertices)
+{
+    using Kernel = FilteredKernel;
+
+    // a polygon with a hole as in overlay, small enough not to cross it
+    auto outer = random_ring(num_vertices);
+    auto center = Point(0, 0);
+    for (const auto &p : outer)
+    {
+        center = center + p / double(outer.size());
+    }
+    auto hole = vector<Point>(outer.rbegin(), outer.rend());
+    for (auto &p : hole)
+    {
+        p = center + (p - center) * 0.15;
+    }
+
+    auto triangles = timed([&]() { return triangulate<Kernel>({outer, hole}); });
+    cout << "monotone, vertices: " << 2 * num_vertices << ", triangles: " << triangles.first.size() / 3 << ", "
+         << triangles.second << "s" << endl;
+
+    auto seconds = timed([&]() { triangulate<Kernel>({outer}); });
+    cout << "monotone, vertices: " << num_vertices << ", no hole, " << seconds << "s" << endl;
+    if (num_vertices > 100000)
+    {
+        return;
+    }
+    seconds = timed([&]() { ear_clipping(outer); });
+    cout << "ear clipping, vertices: " << num_vertices << ", no hole, " << seconds << "s" << endl;
 }
 
 int main(int argc, char *argv[])
 {
-    size_t num_segments = argc < 2 ? 5 : stoi(argv[1]);
-    vector<Segment> segments;
-    segments.reserve(num_segments);
-    for (int i = 0; i < num_segments; ++i)
+    auto mode = string(argc > 1 ? argv[1] : "");
+    if (mode == "bench")
     {
-        segments.push_back(random_segment());
+        benchmark(argc < 3 ? 1000 : stoi(argv[2]));
+        return 0;
+    }
+    if (mode == "degenerate")
+    {
+        return degenerate(argc < 3 ? 200 : stoi(argv[2]), argc < 4 ? 200 : stoi(argv[3])) ? 0 : 1;
+    }
+    if (mode == "chains")
+    {
+        return chains(argc < 3 ? 300 : stoi(argv[2]), argc < 4 ? 300 : stoi(argv[3])) ? 0 : 1;
+    }
+    if (mode == "node")
+    {
+        node(argc < 3 ? 20 : stoi(argv[2]));
+        return 0;
+    }
+    if (mode == "dcel")
+    {
+        return arrangement(argc < 3 ? 1000 : stoi(argv[2])) ? 0 : 1;
+    }
+    if (mode == "boolean")
+    {
+        overlay(argc < 3 ? 20 : stoi(argv[2]), argc < 4 ? "union" : argv[3]);
+        return 0;
+    }
+    if (mode == "validate")
+    {
+        validate(argc < 3 ? 100000 : stoi(argv[2]), argc < 4 ? 20 : stoi(argv[3]));
+        return 0;
+    }
+    if (mode == "ortho")
+    {
+        return manhattan(argc < 3 ? 10000 : stoi(argv[2])) ? 0 : 1;
+    }
+    if (mode == "boxes")
+    {
+        boxes(argc < 3 ? 100000 : stoi(argv[2]));
+        return 0;
+    }
+    if (mode == "clearance")
+    {
+        clearance(argc < 3 ? 100000 : stoi(argv[2]), argc < 4 ? 0.01 : stod(argv[3]));
+        return 0;
     }
-    sweep_line(segments);
+    if (mode == "save")
+    {
+        save(argc < 3 ? 1000 : stoi(argv[2]), argc < 4 ? "segments.bin" : argv[3], argc < 5 ? 0 : stod(argv[4]));
+        return 0;
+    }
+    if (mode == "load")
+    {
+        return load(argc < 3 ? "segments.bin" : argv[2]) ? 0 : 1;
+    }
+    if (mode == "external")
+    {
+        // by default the events found on the way outgrow their half of the budget
+        out_of_core(argc < 3 ? 1000000 : stoi(argv[2]), argc < 4 ? 0.25 : stod(argv[3]), argc < 5 ? 10 : stod(argv[4]));
+        return 0;
+    }
+    if (mode == "tiles")
+    {
+        return tiled(argc < 3 ? 1000000 : stoi(argv[2]), argc < 4 ? 4 : stoi(argv[3]), argc < 5 ? 1 : stod(argv[4]))
+                   ? 0
+                   : 1;
+    }
+    if (mode == "shards")
+    {
+        return sharded(argc < 3 ? 1000000 : stoi(argv[2]), argc < 4 ? 4 : stoi(argv[3]), argc < 5 ? 1 : stod(argv[4]),
+                       argc < 6 ? 256 : stoi(argv[5]))
+                   ? 0
+                   : 1;
+    }
+    if (mode == "output")
+    {
+        return write_intersections(argc < 3 ? 1000000 : stoi(argv[2]), argc < 4 ? 1 : stod(argv[3])) ? 0 : 1;
+    }
+    if (mode == "adjacency")
+    {
+        graph(argc < 3 ? 1000000 : stoi(argv[2]), argc < 4 ? 1 : stoi(argv[3]), argc < 5 ? 1 : stod(argv[4]));
+        return 0;
+    }
+    if (mode == "online")
+    {
+        online(argc < 3 ? 1000000 : stoi(argv[2]), argc < 4 ? 1000 : stoi(argv[3]));
+        return 0;
+    }
+    if (mode == "coverage")
+    {
+        coverage(argc < 3 ? 1000000 : stoi(argv[2]));
+        return 0;
+    }
+    if (mode == "voronoi")
+    {
+        // the benchmark is voronoi 10000000, 25s and 1.6GB of which the
+        // diagram is most
+        tessellate(argc < 3 ? 1000000 : stoi(argv[2]));
+        return 0;
+    }
+    if (mode == "triangulate")
+    {
+        mesh(argc < 3 ? 100000 : stoi(argv[2]));
+        return 0;
+    }
+    if (mode == "snap")
+    {
+        snap(argc < 3 ? 20 : stoi(argv[2]), argc < 4 ? 0.1 : stod(argv[3]));
+        return 0;
+    }
+
+    size_t num_segments = argc < 2 ? 5 : stoi(argv[1]);
+    illustrate(convert<FilteredKernel>(random_segments(num_segments), 1));
     return 0;
 }
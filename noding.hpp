@@ -0,0 +1,106 @@
+#ifndef NODING_HPP
+#define NODING_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include "sweep_line.hpp"
+#include "parallel.hpp"
+
+// Split points of every segment in a compressed (CSR) layout: the interior
+// intersection points of segment i are points[offsets[i] .. offsets[i + 1]),
+// ordered from a to b.
+template <class Kernel>
+struct Noding
+{
+    using EventPoint = typename Kernel::EventPoint;
+
+    std::vector<size_t> offsets;
+    std::vector<EventPoint> points;
+
+    size_t num_splits(size_t id) const
+    {
+        return offsets[id + 1] - offsets[id];
+    }
+
+    // visit the pieces (from, to) of the segment in order from a to b
+    template <class Visitor>
+    void for_each_sub_segment(const Segment<Kernel> &segment, size_t id, Visitor &&visit) const
+    {
+        auto from = Kernel::to_event_point(segment.a);
+        for (size_t i = offsets[id]; i < offsets[id + 1]; ++i)
+        {
+            visit(from, points[i]);
+            from = points[i];
+        }
+        visit(from, Kernel::to_event_point(segment.b));
+    }
+};
+
+// Node the segments: the sweep appends (segment id, point) for every
+// segment through an event point other than at its endpoints, then a
+// counting sort on the id builds the CSR arrays.
+template <class Kernel>
+Noding<Kernel> node(const std::vector<Segment<Kernel>> &segments)
+{
+    using EventPoint = typename Kernel::EventPoint;
+
+    auto ids = std::vector<size_t>();
+    auto splits = std::vector<EventPoint>();
+
+    sweep_line(segments, [&](const auto &point, const auto &, const auto &status) {
+        auto split = [&](const Segment<Kernel> &segment) {
+            if (!Kernel::equal(point, Kernel::to_event_point(segment.a)) &&
+                !Kernel::equal(point, Kernel::to_event_point(segment.b)))
+            {
+                ids.push_back(segment.id);
+                splits.push_back(point);
+            }
+        };
+        // the segments still on the sweep line, the leaving ones end here
+        auto through = segments_through(status, point);
+        for (auto it = through.first; it != through.second; ++it)
+        {
+            split(*it);
+        }
+    });
+
+    auto noding = Noding<Kernel>();
+    noding.offsets.assign(segments.size() + 1, 0);
+    for (auto id : ids)
+    {
+        ++noding.offsets[id + 1];
+    }
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        noding.offsets[i + 1] += noding.offsets[i];
+    }
+
+    // stable, so each segment keeps the sweep order, from the upper endpoint down
+    noding.points.resize(splits.size());
+    {
+        auto next = std::vector<size_t>(noding.offsets.begin(), noding.offsets.end() - 1);
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            noding.points[next[ids[i]]++] = splits[i];
+        }
+    }
+
+    // the sweep order is the order along the segment, it only has to be
+    // reversed for the segments directed upwards
+    parallel_for(segments.size(), [&](size_t first, size_t last) {
+        for (size_t id = first; id < last; ++id)
+        {
+            const auto &segment = segments[id];
+            if (vertically_less(segment.a, segment.b))
+            {
+                std::reverse(noding.points.begin() + noding.offsets[id],
+                             noding.points.begin() + noding.offsets[id + 1]);
+            }
+        }
+    });
+
+    return noding;
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef ONLINE_SWEEP_HPP
+#define ONLINE_SWEEP_HPP
+
+#include <queue>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+#include "sweep_line.hpp"
+
+// The endpoint events of segments pushed as they come, for sweep_line: both
+// endpoints of a segment are queued when it is pushed, so the heap holds
+// every endpoint not reached yet, upper and lower, with the next one on
+// top; a segment leaves it once the sweep is past its lower endpoint.
+template <class Kernel>
+class StreamEndpoints
+{
+  public:
+    bool empty() const
+    {
+        return endpoints.empty();
+    }
+
+    typename Kernel::EventPoint point() const
+    {
+        return endpoints.top().point;
+    }
+
+    bool upper() const
+    {
+        return endpoints.top().upper;
+    }
+
+    Segment<Kernel> segment() const
+    {
+        return endpoints.top().segment;
+    }
+
+    void pop()
+    {
+        endpoints.pop();
+    }
+
+    // a segment keyed at its upper endpoint, as input_segment makes them
+    void push(const Segment<Kernel> &segment)
+    {
+        endpoints.push({segment.key, true, segment});
+        endpoints.push({Kernel::to_event_point(segment.lower_endpoint()), false, segment});
+    }
+
+  private:
+    struct Endpoint
+    {
+        typename Kernel::EventPoint point;
+        bool upper;
+        Segment<Kernel> segment;
+    };
+
+    struct VerticallyLess
+    {
+        bool operator()(const Endpoint &a, const Endpoint &b) const
+        {
+            return Kernel::vertically_less(a.point, b.point);
+        }
+    };
+
+    std::priority_queue<Endpoint, std::vector<Endpoint>, VerticallyLess> endpoints;
+};
+
+// Sweep of segments pushed as they come with their upper endpoints going
+// down, e.g. in time order. advance(watermark) promises that no segment
+// pushed later starts above the watermark in sweep order, and handles
+// every event point above it, calling observer(point, events, status) as
+// sweep_line does; finish() handles the rest. Segments are numbered in the
+// order they are pushed. Only the segments pushed and not swept past are
+// held, in the endpoint heap and on the sweep line, and the pending events.
+template <class Kernel, class Observer>
+class OnlineSweep
+{
+  public:
+    using Point = typename Kernel::Point;
+    using EventPoint = typename Kernel::EventPoint;
+
+    explicit OnlineSweep(Observer observer) : observer(std::move(observer))
+    {
+    }
+
+    // the id of the segment; it may not start above the watermark
+    size_t push(const Point &a, const Point &b)
+    {
+        auto segment = Segment<Kernel>{a, b};
+        segment.id = count;
+        segment.key = Kernel::to_event_point(segment.upper_endpoint());
+        if (has_watermark && Kernel::vertically_less(watermark, segment.key))
+        {
+            throw std::invalid_argument("the segment starts above the watermark");
+        }
+        endpoints.push(segment);
+        return count++;
+    }
+
+    // For a watermark y alone, a point at y right of all the segments: at
+    // equal y the sweep goes right to left.
+    void advance(const Point &watermark)
+    {
+        auto point = Kernel::to_event_point(watermark);
+        if (has_watermark && Kernel::vertically_less(this->watermark, point))
+        {
+            throw std::invalid_argument("the watermark only goes down");
+        }
+        this->watermark = point;
+        has_watermark = true;
+        sweep([this](const EventPoint &next) { return Kernel::vertically_less(this->watermark, next); });
+    }
+
+    void finish()
+    {
+        sweep([](const EventPoint &) { return true; });
+    }
+
+    // segments on the sweep line
+    size_t active() const
+    {
+        return status.size();
+    }
+
+    // segments pushed so far
+    size_t size() const
+    {
+        return count;
+    }
+
+  private:
+    template <class Above>
+    void sweep(Above &&above)
+    {
+        while (!stopped && (!endpoints.empty() || !events.empty()))
+        {
+            auto next = !endpoints.empty() && (events.empty() || Kernel::vertically_less(events.top().point,
+                                                                                         endpoints.point()))
+                            ? endpoints.point()
+                            : events.top().point;
+            if (!above(next))
+            {
+                return;
+            }
+            // no monotone chains, the input is never read
+            stopped = !sweep_next_point(none, endpoints, events, status, observer);
+        }
+    }
+
+    Observer observer;
+    const std::vector<Segment<Kernel>> none;
+    StreamEndpoints<Kernel> endpoints;
+    EventQueue<Kernel> events;
+    Status<Kernel> status;
+    EventPoint watermark;
+    bool has_watermark = false, stopped = false;
+    size_t count = 0;
+};
+
+template <class Kernel, class Observer>
+OnlineSweep<Kernel, std::decay_t<Observer>> online_sweep(Observer &&observer)
+{
+    return OnlineSweep<Kernel, std::decay_t<Observer>>(std::forward<Observer>(observer));
+}
+
+#endif
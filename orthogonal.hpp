@@ -0,0 +1,216 @@
+#ifndef ORTHOGONAL_HPP
+#define ORTHOGONAL_HPP
+
+#include <set>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "sweep_line.hpp"
+
+// Intersections of horizontal and vertical segments by the classic
+// interval sweep, top to bottom: the vertical segments crossing the sweep
+// line are kept by x, and every horizontal segment queries its x range.
+// Only comparisons of input coordinates are needed, so any kernel is
+// exact here. Pairs are closed segments meeting, touching included;
+// parallel segments are not paired with each other. sweep_line reports
+// event points rather than pairs, so the dispatch is in intersecting_pairs
+// and count_intersecting_pairs, which take the interval sweep when the
+// input is orthogonal (is_orthogonal) and sweep_line otherwise.
+
+template <class Kernel>
+bool is_vertical(const Segment<Kernel> &segment)
+{
+    return segment.a.x == segment.b.x;
+}
+
+template <class Kernel>
+bool is_orthogonal(const std::vector<Segment<Kernel>> &segments)
+{
+    return std::all_of(segments.begin(), segments.end(), [](const Segment<Kernel> &segment) {
+        return segment.a.x == segment.b.x || segment.a.y == segment.b.y;
+    });
+}
+
+namespace orthogonal
+{
+// at the same height the vertical segments enter before and leave after
+// the horizontal ones are queried, so that touching counts
+enum class Type
+{
+    enter,
+    query,
+    leave,
+};
+
+template <class Kernel>
+struct Event
+{
+    ::Coordinate<Kernel> y;
+    Type type;
+    size_t id;
+};
+
+template <class Kernel>
+std::vector<Event<Kernel>> events(const std::vector<Segment<Kernel>> &segments)
+{
+    auto result = std::vector<Event<Kernel>>();
+    result.reserve(segments.size() * 2);
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        const auto &segment = segments[i];
+        if (is_vertical(segment))
+        {
+            result.push_back({std::max(segment.a.y, segment.b.y), Type::enter, i});
+            result.push_back({std::min(segment.a.y, segment.b.y), Type::leave, i});
+        }
+        else
+        {
+            result.push_back({segment.a.y, Type::query, i});
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const Event<Kernel> &e1, const Event<Kernel> &e2) {
+        return e1.y != e2.y ? e1.y > e2.y : e1.type < e2.type;
+    });
+    return result;
+}
+} // namespace orthogonal
+
+// report(horizontal, vertical) for every pair of meeting segments, given
+// by index, in O(n log n + k)
+template <class Kernel, class Report>
+void orthogonal_intersections(const std::vector<Segment<Kernel>> &segments, Report &&report)
+{
+    using Coordinate = ::Coordinate<Kernel>;
+    using orthogonal::Type;
+
+    // (x, index) of the vertical segments on the sweep line
+    auto active = std::set<std::pair<Coordinate, size_t>>();
+    for (const auto &event : orthogonal::events(segments))
+    {
+        const auto &segment = segments[event.id];
+        switch (event.type)
+        {
+        case Type::enter:
+            active.insert({segment.a.x, event.id});
+            break;
+        case Type::leave:
+            active.erase({segment.a.x, event.id});
+            break;
+        case Type::query:
+        {
+            auto first = active.lower_bound({std::min(segment.a.x, segment.b.x), 0});
+            auto last = active.upper_bound({std::max(segment.a.x, segment.b.x), size_t(-1)});
+            for (auto it = first; it != last; ++it)
+            {
+                report(event.id, it->second);
+            }
+            break;
+        }
+        }
+    }
+}
+
+// number of pairs orthogonal_intersections reports, in O(n log n) with a
+// Fenwick tree over the x coordinates of the vertical segments
+template <class Kernel>
+size_t count_orthogonal_intersections(const std::vector<Segment<Kernel>> &segments)
+{
+    using Coordinate = ::Coordinate<Kernel>;
+    using orthogonal::Type;
+
+    auto xs = std::vector<Coordinate>();
+    for (const auto &segment : segments)
+    {
+        if (is_vertical(segment))
+        {
+            xs.push_back(segment.a.x);
+        }
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+
+    // tree[i] counts the active segments at the ranks in (i - lowbit(i), i]
+    auto tree = std::vector<size_t>(xs.size() + 1, 0);
+    auto add = [&tree](size_t rank, size_t value) {
+        for (auto i = rank + 1; i < tree.size(); i += i & -i)
+        {
+            tree[i] += value;
+        }
+    };
+    // active segments at the ranks below
+    auto prefix = [&tree](size_t rank) {
+        size_t sum = 0;
+        for (auto i = rank; i > 0; i -= i & -i)
+        {
+            sum += tree[i];
+        }
+        return sum;
+    };
+    auto rank = [&xs](Coordinate x) {
+        return size_t(std::lower_bound(xs.begin(), xs.end(), x) - xs.begin());
+    };
+
+    size_t count = 0;
+    for (const auto &event : orthogonal::events(segments))
+    {
+        const auto &segment = segments[event.id];
+        switch (event.type)
+        {
+        case Type::enter:
+            add(rank(segment.a.x), 1);
+            break;
+        case Type::leave:
+            add(rank(segment.a.x), size_t(-1)); // subtracts, modulo 2^64
+            break;
+        case Type::query:
+        {
+            auto x1 = std::min(segment.a.x, segment.b.x), x2 = std::max(segment.a.x, segment.b.x);
+            auto last = size_t(std::upper_bound(xs.begin(), xs.end(), x2) - xs.begin());
+            count += prefix(last) - prefix(rank(x1));
+            break;
+        }
+        }
+    }
+    return count;
+}
+
+// report(i, j) with i < j for every pair of segments meeting at a point,
+// parallel ones excluded as in orthogonal_intersections, so that each pair
+// meets once: by the interval sweep for orthogonal input, by sweep_line
+// otherwise
+template <class Kernel, class Report>
+void intersecting_pairs(const std::vector<Segment<Kernel>> &segments, Report &&report)
+{
+    if (is_orthogonal(segments))
+    {
+        orthogonal_intersections(segments, [&report](size_t i, size_t j) { report(std::min(i, j), std::max(i, j)); });
+        return;
+    }
+    auto ids = std::vector<size_t>();
+    sweep_line(segments, [&](const auto &, const auto &events, const auto &) {
+        meeting_pairs(events, ids, [&](size_t i, size_t j) {
+            const auto &s1 = segments[i], &s2 = segments[j];
+            if (Kernel::orientation(s1.a, s1.b, s2.a, s2.b) != 0)
+            {
+                report(i, j);
+            }
+        });
+    });
+}
+
+// number of pairs intersecting_pairs reports, in O(n log n) for orthogonal
+// input
+template <class Kernel>
+size_t count_intersecting_pairs(const std::vector<Segment<Kernel>> &segments)
+{
+    if (is_orthogonal(segments))
+    {
+        return count_orthogonal_intersections(segments);
+    }
+    size_t count = 0;
+    intersecting_pairs(segments, [&count](size_t, size_t) { ++count; });
+    return count;
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+// run f(first, last) over [0, size) split in chunks on the hardware threads
+template <class F>
+void parallel_for(size_t size, F &&f, size_t grain = 1024)
+{
+    auto num_threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), size / grain));
+    auto threads = std::vector<std::thread>();
+    for (size_t t = 1; t < num_threads; ++t)
+    {
+        threads.emplace_back([&f, t, num_threads, size]() {
+            f(size * t / num_threads, size * (t + 1) / num_threads);
+        });
+    }
+    f(0, size / num_threads);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef PREDICATES_HPP
+#define PREDICATES_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Floating point filtered predicates with an exact fallback based on
+// Shewchuk's expansion arithmetic ("Adaptive Precision Floating-Point
+// Arithmetic and Fast Robust Geometric Predicates"). Must not be compiled
+// with -ffast-math.
+
+struct PredicateStatistics
+{
+    size_t evaluations = 0;
+    size_t fallbacks = 0;
+};
+
+// per thread counters of the filtered predicates
+inline PredicateStatistics &predicate_statistics()
+{
+    static thread_local PredicateStatistics statistics;
+    return statistics;
+}
+
+// a + b = x + y exactly
+inline void two_sum(double a, double b, double &x, double &y)
+{
+    x = a + b;
+    double bv = x - a;
+    double av = x - bv;
+    y = (a - av) + (b - bv);
+}
+
+// a * b = x + y exactly
+inline void two_product(double a, double b, double &x, double &y)
+{
+    x = a * b;
+#ifdef __FMA__
+    y = std::fma(a, b, -x);
+#else
+    // Dekker's product, std::fma is emulated in software without FMA
+    auto split = [](double a, double &hi, double &lo) {
+        static const double splitter = 134217729.0; // 2^27 + 1
+        double c = splitter * a;
+        double big = c - a;
+        hi = c - big;
+        lo = a - hi;
+    };
+    double ahi, alo, bhi, blo;
+    split(a, ahi, alo);
+    split(b, bhi, blo);
+    double err1 = x - ahi * bhi;
+    double err2 = err1 - alo * bhi;
+    double err3 = err2 - ahi * blo;
+    y = alo * blo - err3;
+#endif
+}
+
+// h = e + b, e and h are nonoverlapping expansions in increasing magnitude,
+// zero components are eliminated; returns the length of h
+inline int grow_expansion(int elen, const double *e, double b, double *h)
+{
+    double q = b;
+    int hlen = 0;
+    for (int i = 0; i < elen; ++i)
+    {
+        double sum, tail;
+        two_sum(q, e[i], sum, tail);
+        q = sum;
+        if (tail != 0)
+        {
+            h[hlen++] = tail;
+        }
+    }
+    if (q != 0 || hlen == 0)
+    {
+        h[hlen++] = q;
+    }
+    return hlen;
+}
+
+// Arbitrary precision value as a nonoverlapping expansion, components in
+// increasing magnitude; for the rare exact evaluations only
+struct expansion
+{
+    std::vector<double> components;
+
+    expansion(double value = 0)
+    {
+        components.push_back(value);
+    }
+
+    int sign() const
+    {
+        double top = components.back();
+        return (top > 0) - (top < 0);
+    }
+
+    double estimate() const
+    {
+        double sum = 0;
+        for (auto component : components)
+        {
+            sum += component;
+        }
+        return sum;
+    }
+
+    friend expansion operator-(expansion e)
+    {
+        for (auto &component : e.components)
+        {
+            component = -component;
+        }
+        return e;
+    }
+
+    friend expansion operator+(const expansion &e, const expansion &f)
+    {
+        auto h = e;
+        auto buffer = std::vector<double>();
+        for (auto component : f.components)
+        {
+            buffer.resize(h.components.size() + 1);
+            buffer.resize(grow_expansion(h.components.size(), h.components.data(), component, buffer.data()));
+            std::swap(buffer, h.components);
+        }
+        return h;
+    }
+
+    friend expansion operator-(const expansion &e, const expansion &f)
+    {
+        return e + -f;
+    }
+
+    // Shewchuk's scale_expansion with zero elimination, summed over f
+    friend expansion operator*(const expansion &e, const expansion &f)
+    {
+        auto result = expansion();
+        for (auto b : f.components)
+        {
+            auto h = expansion();
+            h.components.clear();
+            double q, tail;
+            two_product(e.components[0], b, q, tail);
+            if (tail != 0)
+            {
+                h.components.push_back(tail);
+            }
+            for (size_t i = 1; i < e.components.size(); ++i)
+            {
+                double product, product_tail, sum;
+                two_product(e.components[i], b, product, product_tail);
+                two_sum(q, product_tail, sum, tail);
+                if (tail != 0)
+                {
+                    h.components.push_back(tail);
+                }
+                two_sum(product, sum, q, tail);
+                if (tail != 0)
+                {
+                    h.components.push_back(tail);
+                }
+            }
+            if (q != 0 || h.components.empty())
+            {
+                h.components.push_back(q);
+            }
+            result = result + h;
+        }
+        return result;
+    }
+};
+
+// exact sign of sum(a[i] * b[i]) for n products
+template <int n>
+int exact_sign_of_products(const double (&a)[n], const double (&b)[n])
+{
+    double e[2 * n + 1];
+    double h[2 * n + 1];
+    int elen = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        double x, y;
+        two_product(a[i], b[i], x, y);
+        elen = grow_expansion(elen, e, y, h);
+        elen = grow_expansion(elen, h, x, e);
+    }
+    // the most significant component decides
+    double top = e[elen - 1];
+    return (top > 0) - (top < 0);
+}
+
+// Shewchuk's error bounds, epsilon is half an ulp of 1
+constexpr double predicate_epsilon = std::numeric_limits<double>::epsilon() / 2;
+constexpr double cross_bound_a = (3 + 16 * predicate_epsilon) * predicate_epsilon;
+constexpr double cross_bound_b = (2 + 12 * predicate_epsilon) * predicate_epsilon;
+constexpr double cross_bound_c = (9 + 64 * predicate_epsilon) * predicate_epsilon * predicate_epsilon;
+constexpr double result_bound = (3 + 8 * predicate_epsilon) * predicate_epsilon;
+
+// stages B to D of filtered_cross, sum is |ux * vy| + |uy * vx|
+[[gnu::noinline]] inline int adaptive_cross(double ax, double ay, double bx, double by,
+                                            double cx, double cy, double dx, double dy,
+                                            double sum)
+{
+    auto sign = [](double det) {
+        return (det > 0) - (det < 0);
+    };
+
+    ++predicate_statistics().fallbacks;
+
+    // exact value for the rounded differences
+    double ux = bx - ax, uy = by - ay;
+    double vx = dx - cx, vy = dy - cy;
+    double x1, y1, x2, y2;
+    two_product(ux, vy, x1, y1);
+    two_product(uy, vx, x2, y2);
+    double e[4] = {y1, x1}, h[4];
+    int len = grow_expansion(2, e, -y2, h);
+    len = grow_expansion(len, h, -x2, e);
+    double det = 0;
+    for (int i = 0; i < len; ++i)
+    {
+        det += e[i];
+    }
+    double bound = cross_bound_b * sum;
+    if (det >= bound || -det >= bound)
+    {
+        return sign(det);
+    }
+
+    double rounded, uxt, uyt, vxt, vyt;
+    two_sum(bx, -ax, rounded, uxt);
+    two_sum(by, -ay, rounded, uyt);
+    two_sum(dx, -cx, rounded, vxt);
+    two_sum(dy, -cy, rounded, vyt);
+    if (uxt == 0 && uyt == 0 && vxt == 0 && vyt == 0)
+    {
+        return sign(det);
+    }
+
+    // first order correction by the tails of the differences
+    bound = cross_bound_c * sum + result_bound * std::abs(det);
+    det += (ux * vyt + vy * uxt) - (uy * vxt + vx * uyt);
+    if (det >= bound || -det >= bound)
+    {
+        return sign(det);
+    }
+
+    const double a[8] = {bx, -bx, -ax, ax, -by, by, ay, -ay};
+    const double b[8] = {dy, cy, dy, cy, dx, cx, dx, cx};
+    return exact_sign_of_products(a, b);
+}
+
+// sign of (b - a) x (d - c), i.e. (bx - ax)(dy - cy) - (by - ay)(dx - cx),
+// adaptive in the same stages as Shewchuk's orient2d
+inline int filtered_cross(double ax, double ay, double bx, double by,
+                          double cx, double cy, double dx, double dy)
+{
+    ++predicate_statistics().evaluations;
+
+    double left = (bx - ax) * (dy - cy);
+    double right = (by - ay) * (dx - cx);
+    double det = left - right;
+    // different signs or a zero term are always decided here
+    double sum = std::abs(left) + std::abs(right);
+    if (std::abs(det) >= cross_bound_a * sum)
+    {
+        return (det > 0) - (det < 0);
+    }
+    return adaptive_cross(ax, ay, bx, by, cx, cy, dx, dy, sum);
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef PROXIMITY_HPP
+#define PROXIMITY_HPP
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+#include "sweep_line.hpp"
+#include "rectangles.hpp"
+#include "predicates.hpp"
+
+// Pairs of segments closer than a distance epsilon, for clearance checks.
+// The bounding boxes are widened by epsilon and pruned for overlaps by
+// sorting in x (rectangles.hpp), then each candidate pair is decided
+// exactly. This is not a sweep of the segments widened by epsilon with
+// distance tests against status neighbors: its cost follows the boxes
+// overlapping in x, not the pairs found. The distance test squares
+// differences of input coordinates, so it is evaluated in double with an
+// error bound and redone with expansions (predicates.hpp) only when the
+// pair is too close to epsilon to tell.
+
+namespace proximity
+{
+// sign of an expression evaluated in double as value, which is off by at
+// most 32 ulps of magnitude, the same expression with absolute values;
+// exact() evaluates it as an expansion otherwise
+template <class Exact>
+int filtered_sign(double value, double magnitude, Exact &&exact)
+{
+    ++predicate_statistics().evaluations;
+    if (std::abs(value) > 32 * predicate_epsilon * magnitude)
+    {
+        return (value > 0) - (value < 0);
+    }
+    ++predicate_statistics().fallbacks;
+    return exact().sign();
+}
+
+// whether p is within epsilon of the segment from a to b: the closest
+// point is a, b or the projection of p in between
+inline bool point_within(const vector2<double> &p, const vector2<double> &a, const vector2<double> &b,
+                         double epsilon)
+{
+    using E = expansion;
+    auto d = b - a, w = p - a, v = p - b;
+    auto e2 = epsilon * epsilon;
+    auto exact_e2 = [epsilon]() {
+        return E(epsilon) * E(epsilon);
+    };
+    auto exact_dot = [](const vector2<double> &p, const vector2<double> &q, const vector2<double> &r,
+                        const vector2<double> &s) {
+        return (E(q.x) - E(p.x)) * (E(s.x) - E(r.x)) + (E(q.y) - E(p.y)) * (E(s.y) - E(r.y));
+    };
+    // |p - q|^2 <= epsilon^2
+    auto near = [&](const vector2<double> &p, const vector2<double> &q) {
+        auto u = p - q;
+        auto value = dot(u, u) - e2;
+        return filtered_sign(value, dot(u, u) + e2, [&]() { return exact_dot(q, p, q, p) - exact_e2(); }) <= 0;
+    };
+
+    auto magnitude = [](const vector2<double> &u, const vector2<double> &v) {
+        return std::abs(u.x * v.x) + std::abs(u.y * v.y);
+    };
+    if (filtered_sign(dot(w, d), magnitude(w, d), [&]() { return exact_dot(a, p, a, b); }) <= 0)
+    {
+        return near(p, a);
+    }
+    if (filtered_sign(dot(v, d), magnitude(v, d), [&]() { return exact_dot(b, p, a, b); }) >= 0)
+    {
+        return near(p, b);
+    }
+    // cross(d, w)^2 <= epsilon^2 |d|^2
+    auto c = cross(d, w);
+    auto bound = std::abs(d.x * w.y) + std::abs(d.y * w.x);
+    auto value = c * c - e2 * dot(d, d);
+    return filtered_sign(value, bound * bound + e2 * dot(d, d), [&]() {
+               auto exact_cross = (E(b.x) - E(a.x)) * (E(p.y) - E(a.y)) - (E(b.y) - E(a.y)) * (E(p.x) - E(a.x));
+               return exact_cross * exact_cross - exact_e2() * exact_dot(a, b, a, b);
+           }) <= 0;
+}
+} // namespace proximity
+
+// whether the closed segments are within epsilon of each other: they
+// cross, or an endpoint of one is within epsilon of the other
+template <class Kernel>
+bool within_distance(const Segment<Kernel> &s1, const Segment<Kernel> &s2, double epsilon)
+{
+    auto side = [](const typename Kernel::Point &a, const typename Kernel::Point &b, const typename Kernel::Point &p) {
+        return Kernel::orientation(a, b, Kernel::to_event_point(p));
+    };
+    if (side(s1.a, s1.b, s2.a) * side(s1.a, s1.b, s2.b) < 0 && side(s2.a, s2.b, s1.a) * side(s2.a, s2.b, s1.b) < 0)
+    {
+        return true;
+    }
+    // input coordinates are exact in double, see ExactKernel::max_coordinate
+    auto a = Kernel::to_double(s1.a), b = Kernel::to_double(s1.b);
+    auto c = Kernel::to_double(s2.a), d = Kernel::to_double(s2.b);
+    return proximity::point_within(c, a, b, epsilon) || proximity::point_within(d, a, b, epsilon) ||
+           proximity::point_within(a, c, d, epsilon) || proximity::point_within(b, c, d, epsilon);
+}
+
+// Calls visit(block) with blocks of pairs of segment indices (i, j) within
+// epsilon of each other, each pair once, concurrently as
+// overlapping_boxes does, and in its time: the widened boxes overlapping
+// in x are all compared in y, which is only close to the pairs found for
+// short segments.
+template <class Kernel, class Visitor>
+void box_pruned_close_pairs(const std::vector<Segment<Kernel>> &segments, double epsilon, Visitor &&visit,
+                            size_t block_size = 4096)
+{
+    using Coordinate = ::Coordinate<Kernel>;
+
+    // boxes within epsilon of each other overlap once one side is moved
+    // out by epsilon, rounded up
+    auto widen = [epsilon](Coordinate x) {
+        if constexpr (std::is_integral<Coordinate>::value)
+        {
+            return x + Coordinate(std::ceil(epsilon));
+        }
+        else
+        {
+            return std::nextafter(x + epsilon, std::numeric_limits<Coordinate>::infinity());
+        }
+    };
+    auto boxes = std::vector<Box<Kernel>>(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        boxes[i] = bounding_box(segments[i]);
+        boxes[i].xhi = widen(boxes[i].xhi);
+        boxes[i].yhi = widen(boxes[i].yhi);
+    }
+
+    overlapping_boxes(
+        boxes,
+        [&](const std::vector<std::pair<size_t, size_t>> &candidates) {
+            auto block = std::vector<std::pair<size_t, size_t>>();
+            for (const auto &pair : candidates)
+            {
+                if (within_distance(segments[pair.first], segments[pair.second], epsilon))
+                {
+                    block.push_back(pair);
+                }
+            }
+            if (!block.empty())
+            {
+                visit(block);
+            }
+        },
+        block_size);
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef RECTANGLES_HPP
+#define RECTANGLES_HPP
+
+#include <vector>
+#include <utility>
+#include <numeric>
+#include <algorithm>
+
+#include "sweep_line.hpp"
+#include "parallel.hpp"
+
+// Overlapping bounding boxes of segments by sweep and prune: the boxes are
+// sorted by their left side into flat arrays, and each box is only
+// compared in y with the following ones that start before it ends in x. The
+// boxes are closed, so touching ones overlap.
+
+template <class Kernel>
+struct Box
+{
+    Coordinate<Kernel> xlo, ylo, xhi, yhi;
+};
+
+template <class Kernel>
+Box<Kernel> bounding_box(const Segment<Kernel> &segment)
+{
+    return {std::min(segment.a.x, segment.b.x), std::min(segment.a.y, segment.b.y),
+            std::max(segment.a.x, segment.b.x), std::max(segment.a.y, segment.b.y)};
+}
+
+// Calls visit(block) with blocks of at most block_size pairs of box
+// indices (i, j) that overlap, each pair once. The boxes are split among
+// the threads and visit is called concurrently from them, with a block
+// owned by the calling thread, e.g. for intersections(). It takes
+// O(n log n + pairs overlapping in x), not in both: up to quadratic when
+// many boxes share an x range, e.g. long segments or tall ones stacked.
+template <class Kernel, class Visitor>
+void overlapping_boxes(const std::vector<Box<Kernel>> &boxes, Visitor &&visit, size_t block_size = 4096)
+{
+    auto order = std::vector<size_t>(boxes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&boxes](size_t i, size_t j) {
+        return boxes[i].xlo < boxes[j].xlo;
+    });
+    // flat arrays in sorted order, the inner loop only reads the y ones
+    auto xlo = std::vector<Coordinate<Kernel>>(order.size());
+    auto ylo = std::vector<Coordinate<Kernel>>(order.size());
+    auto yhi = std::vector<Coordinate<Kernel>>(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        xlo[i] = boxes[order[i]].xlo;
+        ylo[i] = boxes[order[i]].ylo;
+        yhi[i] = boxes[order[i]].yhi;
+    }
+
+    parallel_for(order.size(), [&](size_t first, size_t last) {
+        auto block = std::vector<std::pair<size_t, size_t>>();
+        block.reserve(block_size);
+        auto hits = std::vector<size_t>();
+        for (size_t i = first; i < last; ++i)
+        {
+            // the boxes starting before this one ends in x
+            auto end = size_t(std::upper_bound(xlo.begin() + i + 1, xlo.end(), boxes[order[i]].xhi) - xlo.begin());
+            // compacted without branches, as the y tests are unpredictable
+            hits.resize(std::max(hits.size(), end - i));
+            auto low = ylo[i], high = yhi[i];
+            size_t num_hits = 0;
+            for (size_t j = i + 1; j < end; ++j)
+            {
+                hits[num_hits] = j;
+                num_hits += (ylo[j] <= high) & (low <= yhi[j]);
+            }
+            for (size_t k = 0; k < num_hits; ++k)
+            {
+                block.push_back({order[i], order[hits[k]]});
+                if (block.size() == block_size)
+                {
+                    visit(block);
+                    block.clear();
+                }
+            }
+        }
+        if (!block.empty())
+        {
+            visit(block);
+        }
+    });
+}
+
+// the pairs of segments whose bounding boxes overlap
+template <class Kernel, class Visitor>
+void overlapping_boxes(const std::vector<Segment<Kernel>> &segments, Visitor &&visit, size_t block_size = 4096)
+{
+    auto boxes = std::vector<Box<Kernel>>(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        boxes[i] = bounding_box(segments[i]);
+    }
+    overlapping_boxes(boxes, std::forward<Visitor>(visit), block_size);
+}
+
+#endif
@@ -0,0 +1,420 @@
+#ifndef SEGMENT_FILE_HPP
+#define SEGMENT_FILE_HPP
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sweep_line.hpp"
+
+// Binary segment files, read in place through mmap. A file is a 64 byte
+// header, then one record per segment, then optionally one uint64 id per
+// segment. Records are four little-endian doubles (ax, ay, bx, by), or four
+// int32 grid coordinates when quantized, a point being (x0 + scale * qx,
+// y0 + scale * qy). All sections are 8 byte aligned.
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "segment files are read in place as little-endian");
+
+namespace segment_file
+{
+constexpr char magic[8] = {'S', 'E', 'G', 'M', 'E', 'N', 'T', 'S'};
+constexpr uint32_t version = 1;
+
+enum Flags : uint32_t
+{
+    quantized = 1,
+    with_ids = 2,
+};
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t count;
+    double scale, x0, y0;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(Header) == 64, "the header is 64 bytes");
+
+struct DoubleRecord
+{
+    double ax, ay, bx, by;
+};
+
+struct QuantizedRecord
+{
+    int32_t ax, ay, bx, by;
+};
+} // namespace segment_file
+
+// contiguous read-only view, std::span is C++20
+template <class T>
+struct Span
+{
+    const T *first = nullptr;
+    size_t count = 0;
+
+    const T *begin() const
+    {
+        return first;
+    }
+
+    const T *end() const
+    {
+        return first + count;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    const T &operator[](size_t i) const
+    {
+        return first[i];
+    }
+};
+
+// A whole file mapped read-only, pages are read in by the kernel as they
+// are touched.
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("cannot open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("cannot open " + path);
+        }
+        length = info.st_size;
+        if (length > 0)
+        {
+            mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::runtime_error("cannot map " + path);
+        }
+        ::madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+        if (length > 0)
+        {
+            ::munmap(mapping, length);
+        }
+    }
+
+    const char *data() const
+    {
+        return static_cast<const char *>(mapping);
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+  private:
+    void *mapping = nullptr;
+    size_t length = 0;
+};
+
+// A segment file mapped read-only, the records are used where they lie.
+class MappedSegments
+{
+  public:
+    explicit MappedSegments(const std::string &path) : file(path)
+    {
+        if (file.size() < sizeof(segment_file::Header))
+        {
+            throw std::runtime_error(path + " is not a segment file");
+        }
+        const auto &header = this->header();
+        auto record_size = quantized() ? sizeof(segment_file::QuantizedRecord) : sizeof(segment_file::DoubleRecord);
+        auto ids_size = header.flags & segment_file::with_ids ? sizeof(uint64_t) : 0;
+        if (std::memcmp(header.magic, segment_file::magic, sizeof(header.magic)) != 0 ||
+            header.version != segment_file::version ||
+            header.count > (file.size() - sizeof(header)) / (record_size + ids_size) ||
+            file.size() != sizeof(header) + header.count * (record_size + ids_size))
+        {
+            throw std::runtime_error(path + " is not a segment file");
+        }
+    }
+
+    const segment_file::Header &header() const
+    {
+        return *reinterpret_cast<const segment_file::Header *>(bytes());
+    }
+
+    size_t size() const
+    {
+        return header().count;
+    }
+
+    bool quantized() const
+    {
+        return header().flags & segment_file::quantized;
+    }
+
+    // empty unless the file is in that format
+    Span<segment_file::DoubleRecord> doubles() const
+    {
+        return {quantized() ? nullptr : records<segment_file::DoubleRecord>(), quantized() ? 0 : size()};
+    }
+
+    Span<segment_file::QuantizedRecord> grid() const
+    {
+        return {quantized() ? records<segment_file::QuantizedRecord>() : nullptr, quantized() ? size() : 0};
+    }
+
+    // empty without ids
+    Span<uint64_t> ids() const
+    {
+        if (!(header().flags & segment_file::with_ids))
+        {
+            return {};
+        }
+        auto record_size = quantized() ? sizeof(segment_file::QuantizedRecord) : sizeof(segment_file::DoubleRecord);
+        return {reinterpret_cast<const uint64_t *>(bytes() + sizeof(segment_file::Header) + size() * record_size),
+                size()};
+    }
+
+    // Endpoint a or b of segment i for a kernel; integer kernels take the
+    // grid coordinates of a quantized file as they are.
+    template <class Kernel>
+    typename Kernel::Point point(size_t i, bool b) const
+    {
+        using Point = typename Kernel::Point;
+        if (quantized())
+        {
+            const auto &r = grid()[i];
+            auto x = b ? r.bx : r.ax, y = b ? r.by : r.ay;
+            if constexpr (std::is_integral<Coordinate<Kernel>>::value)
+            {
+                return Point(x, y);
+            }
+            else
+            {
+                const auto &h = header();
+                return Kernel::from_double(vector2<double>(h.x0 + h.scale * x, h.y0 + h.scale * y));
+            }
+        }
+        const auto &r = doubles()[i];
+        return Kernel::from_double(b ? vector2<double>(r.bx, r.by) : vector2<double>(r.ax, r.ay));
+    }
+
+    template <class Kernel>
+    Segment<Kernel> segment(size_t i) const
+    {
+        return {point<Kernel>(i, false), point<Kernel>(i, true)};
+    }
+
+    template <class Kernel>
+    std::vector<Segment<Kernel>> segments() const
+    {
+        auto result = std::vector<Segment<Kernel>>();
+        result.reserve(size());
+        for (size_t i = 0; i < size(); ++i)
+        {
+            result.push_back(segment<Kernel>(i));
+        }
+        return result;
+    }
+
+  private:
+    const char *bytes() const
+    {
+        return file.data();
+    }
+
+    template <class Record>
+    const Record *records() const
+    {
+        return reinterpret_cast<const Record *>(bytes() + sizeof(segment_file::Header));
+    }
+
+    MappedFile file;
+};
+
+// The segments of a mapped file as segments of a kernel, for the sweep to
+// read in place through SegmentTraits.
+template <class Kernel>
+struct MappedSegmentsView
+{
+    const MappedSegments *file;
+};
+
+template <class K>
+struct SegmentTraits<MappedSegmentsView<K>>
+{
+    using Kernel = K;
+    using Point = typename Kernel::Point;
+
+    static size_t size(const MappedSegmentsView<Kernel> &view)
+    {
+        return view.file->size();
+    }
+
+    static Point a(const MappedSegmentsView<Kernel> &view, size_t i)
+    {
+        return view.file->template point<Kernel>(i, false);
+    }
+
+    static Point b(const MappedSegmentsView<Kernel> &view, size_t i)
+    {
+        return view.file->template point<Kernel>(i, true);
+    }
+
+    static size_t next(const MappedSegmentsView<Kernel> &, size_t)
+    {
+        return size_t(-1);
+    }
+};
+
+// Writes a segment file as the segments come, then the ids if there are
+// any. A positive quantum quantizes the coordinates to a grid of that step
+// from the origin (x0, y0), the segments must lie less than 2^31 steps
+// above and right of it.
+class SegmentFileWriter
+{
+  public:
+    explicit SegmentFileWriter(const std::string &path, double quantum = 0, double x0 = 0, double y0 = 0)
+        : path(path), output(path, std::ios::binary)
+    {
+        std::memcpy(header.magic, segment_file::magic, sizeof(header.magic));
+        header.version = segment_file::version;
+        header.flags = quantum > 0 ? uint32_t(segment_file::quantized) : 0;
+        header.scale = quantum > 0 ? quantum : 1;
+        header.x0 = quantum > 0 ? x0 : 0;
+        header.y0 = quantum > 0 ? y0 : 0;
+        // the count is known at the end
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        check();
+    }
+
+    void add(const vector2<double> &a, const vector2<double> &b)
+    {
+        if (header.flags & segment_file::quantized)
+        {
+            auto record = segment_file::QuantizedRecord{grid(a.x, header.x0), grid(a.y, header.y0),
+                                                        grid(b.x, header.x0), grid(b.y, header.y0)};
+            output.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        }
+        else
+        {
+            auto record = segment_file::DoubleRecord{a.x, a.y, b.x, b.y};
+            output.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        }
+        ++header.count;
+    }
+
+    template <class Kernel>
+    void add(const Segment<Kernel> &segment)
+    {
+        add(Kernel::to_double(segment.a), Kernel::to_double(segment.b));
+    }
+
+    // one id per segment, or none
+    void finish(const std::vector<uint64_t> &ids = {})
+    {
+        if (!ids.empty() && ids.size() != header.count)
+        {
+            throw std::invalid_argument("one id per segment");
+        }
+        output.write(reinterpret_cast<const char *>(ids.data()), ids.size() * sizeof(uint64_t));
+        header.flags |= ids.empty() ? 0 : uint32_t(segment_file::with_ids);
+        output.seekp(0);
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.close();
+        check();
+    }
+
+  private:
+    int32_t grid(double value, double origin) const
+    {
+        auto q = std::llround((value - origin) / header.scale);
+        if (q < 0 || q > std::numeric_limits<int32_t>::max())
+        {
+            throw std::invalid_argument("the segments span too many quanta");
+        }
+        return int32_t(q);
+    }
+
+    void check()
+    {
+        if (!output)
+        {
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+
+    std::string path;
+    std::ofstream output;
+    segment_file::Header header = segment_file::Header();
+};
+
+// Write the segments, with ids if there are any. A positive quantum
+// quantizes the coordinates to a grid of that step from the lower left
+// corner of the segments, which must span less than 2^31 steps.
+template <class Kernel>
+void write_segment_file(const std::string &path, const std::vector<Segment<Kernel>> &segments,
+                        const std::vector<uint64_t> &ids = {}, double quantum = 0)
+{
+    if (!ids.empty() && ids.size() != segments.size())
+    {
+        throw std::invalid_argument("one id per segment");
+    }
+    double x0 = 0, y0 = 0;
+    if (quantum > 0)
+    {
+        x0 = y0 = std::numeric_limits<double>::infinity();
+        for (const auto &segment : segments)
+        {
+            for (const auto &p : {Kernel::to_double(segment.a), Kernel::to_double(segment.b)})
+            {
+                x0 = std::min(x0, p.x);
+                y0 = std::min(y0, p.y);
+            }
+        }
+    }
+
+    auto writer = SegmentFileWriter(path, quantum, x0, y0);
+    for (const auto &segment : segments)
+    {
+        writer.add(segment);
+    }
+    writer.finish(ids);
+}
+
+#endif
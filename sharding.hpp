@@ -0,0 +1,280 @@
+#ifndef SHARDING_HPP
+#define SHARDING_HPP
+
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "tiling.hpp"
+
+// Intersections by forked worker processes, each sweeping a horizontal
+// slab of the input as tiled_intersections sweeps a tile, so that a worker
+// that crashes takes no other one down. The workers get the input and
+// their segments from the parent as they are at the fork, e.g. a mapped
+// segment file whose pages stay shared, and hand their records back
+// through a ring buffer in shared memory each. The parent drains all the
+// rings as they fill and visits the slabs from the top one down, which is
+// sweep order; the records of a slab below the one being visited are held
+// in memory until its turn, up to all the records but the top slab's.
+
+namespace sharding
+{
+// Single producer single consumer ring of records in a shared anonymous
+// mapping, made before the fork; the positions count records from the
+// start and only grow.
+template <class Record>
+class SharedRing
+{
+  public:
+    static_assert(std::is_trivially_copyable<Record>::value, "records are copied between processes as they are");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "the positions are shared between processes");
+
+    enum State : uint32_t
+    {
+        running,
+        done,
+        failed,
+    };
+
+    explicit SharedRing(size_t capacity) : capacity(std::max<size_t>(1, capacity))
+    {
+        length = sizeof(Header) + this->capacity * sizeof(Record);
+        mapping = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::runtime_error("cannot map a shared ring");
+        }
+        new (mapping) Header();
+    }
+
+    SharedRing(const SharedRing &) = delete;
+    SharedRing &operator=(const SharedRing &) = delete;
+
+    ~SharedRing()
+    {
+        ::munmap(mapping, length);
+    }
+
+    // in the worker, waits while the ring is full
+    void push(const Record &record)
+    {
+        auto head = header().head.load(std::memory_order_relaxed);
+        while (head - header().tail.load(std::memory_order_acquire) == capacity)
+        {
+            pause();
+        }
+        records()[head % capacity] = record;
+        header().head.store(head + 1, std::memory_order_release);
+    }
+
+    void finish(State state)
+    {
+        header().state.store(state, std::memory_order_release);
+    }
+
+    // in the parent, calls visit(record) for the records pushed so far and
+    // returns their number
+    template <class Visitor>
+    size_t drain(Visitor &&visit)
+    {
+        auto tail = header().tail.load(std::memory_order_relaxed);
+        auto head = header().head.load(std::memory_order_acquire);
+        for (auto position = tail; position != head; ++position)
+        {
+            visit(records()[position % capacity]);
+        }
+        header().tail.store(head, std::memory_order_release);
+        return head - tail;
+    }
+
+    State state() const
+    {
+        return State(header().state.load(std::memory_order_acquire));
+    }
+
+    // wait a little for the other process
+    static void pause()
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+  private:
+    struct alignas(64) Header
+    {
+        std::atomic<uint64_t> head{0}; // written by the worker
+        alignas(64) std::atomic<uint64_t> tail{0}; // read by the parent
+        std::atomic<uint32_t> state{running};
+    };
+
+    Header &header() const
+    {
+        return *static_cast<Header *>(mapping);
+    }
+
+    Record *records() const
+    {
+        return reinterpret_cast<Record *>(static_cast<char *>(mapping) + sizeof(Header));
+    }
+
+    size_t capacity, length;
+    void *mapping;
+};
+} // namespace sharding
+
+// Calls visit(record) with the intersection records of the segments in
+// sweep order, computed by num_workers processes over as many slabs. Each
+// worker has a ring of ring_size records. Throws if a worker fails, after
+// stopping the others.
+template <class Segments, class Visitor>
+void sharded_intersections(const Segments &segments, size_t num_workers, Visitor &&visit, size_t ring_size = 1 << 16,
+                           double halo = -1)
+{
+    using Kernel = typename SegmentTraits<Segments>::Kernel;
+    using Ring = sharding::SharedRing<IntersectionRecord<Kernel>>;
+
+    auto grid = tile_grid(segments, 1, num_workers);
+    auto slabs = tile_segments(segments, grid, halo);
+    auto rings = std::vector<std::unique_ptr<Ring>>();
+    for (size_t k = 0; k < num_workers; ++k)
+    {
+        rings.push_back(std::make_unique<Ring>(ring_size));
+    }
+
+    auto workers = std::vector<pid_t>(num_workers, -1);
+    auto stop = [&workers]() {
+        for (auto &pid : workers)
+        {
+            if (pid > 0)
+            {
+                ::kill(pid, SIGKILL);
+                ::waitpid(pid, nullptr, 0);
+                pid = -1;
+            }
+        }
+    };
+    for (size_t k = 0; k < num_workers; ++k)
+    {
+        auto pid = ::fork();
+        if (pid < 0)
+        {
+            stop();
+            throw std::runtime_error("cannot fork a worker");
+        }
+        if (pid == 0)
+        {
+            // the worker leaves without unwinding the parent's state
+            auto &ring = *rings[k];
+            try
+            {
+                sweep_tile(segments, grid, k, slabs[k],
+                           [&ring](const IntersectionRecord<Kernel> &record) { ring.push(record); });
+                ring.finish(Ring::done);
+                ::_exit(0);
+            }
+            catch (...)
+            {
+                ring.finish(Ring::failed);
+                ::_exit(1);
+            }
+        }
+        workers[k] = pid;
+    }
+    slabs = {};
+
+    // The rows of the grid go up, the sweep goes down: the top slab not
+    // done yet is visited as it comes, the rings of the others are drained
+    // into buffers on every round too, so that no worker waits on a full
+    // ring for the slabs above it, and each buffer is visited when its slab
+    // comes up.
+    auto buffers = std::vector<std::vector<IntersectionRecord<Kernel>>>(num_workers);
+    auto finished = std::vector<bool>(num_workers, false);
+    size_t current = num_workers;
+    try
+    {
+        while (current > 0)
+        {
+            size_t drained = 0;
+            for (size_t k = 0; k < current; ++k)
+            {
+                if (finished[k])
+                {
+                    continue;
+                }
+                auto &ring = *rings[k];
+                // the state is read first, so that nothing pushed before done is missed
+                auto state = ring.state();
+                if (k + 1 == current)
+                {
+                    drained += ring.drain(visit);
+                }
+                else
+                {
+                    drained += ring.drain([&buffer = buffers[k]](const IntersectionRecord<Kernel> &record) {
+                        buffer.push_back(record);
+                    });
+                }
+                if (state == Ring::done)
+                {
+                    finished[k] = true;
+                    continue;
+                }
+                if (state == Ring::failed)
+                {
+                    throw std::runtime_error("worker " + std::to_string(k) + " failed");
+                }
+                if (workers[k] > 0 && ::waitpid(workers[k], nullptr, WNOHANG) == workers[k])
+                {
+                    // exited; it may have finished after the state was
+                    // read, which the next round sees
+                    workers[k] = -1;
+                    if (ring.state() != Ring::done)
+                    {
+                        throw std::runtime_error("worker " + std::to_string(k) + " failed");
+                    }
+                }
+            }
+            while (current > 0 && finished[current - 1])
+            {
+                if (--current > 0)
+                {
+                    for (const auto &record : buffers[current - 1])
+                    {
+                        visit(record);
+                    }
+                    buffers[current - 1] = {};
+                }
+            }
+            if (drained == 0)
+            {
+                Ring::pause();
+            }
+        }
+    }
+    catch (...)
+    {
+        stop();
+        throw;
+    }
+    for (auto &pid : workers)
+    {
+        if (pid > 0)
+        {
+            ::waitpid(pid, nullptr, 0);
+            pid = -1;
+        }
+    }
+}
+
+#endif
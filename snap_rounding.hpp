@@ -0,0 +1,181 @@
+#ifndef SNAP_ROUNDING_HPP
+#define SNAP_ROUNDING_HPP
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "sweep_line.hpp"
+
+// Iterated snap rounding (Halperin and Packer) onto an integer grid whose
+// pixel (i, j) is the square of side 1 centered at (i, j), in units of the
+// pixel size. Every event point of the sweep makes its pixel hot; each
+// segment is then rerouted through the centers of the hot pixels it
+// crosses, and the new fragments again until no fragment crosses a hot
+// pixel other than its ends. The output polylines only meet at pixel
+// centers, so they are consistent when stored on the grid.
+
+using GridPoint = vector2<int64_t>;
+
+inline GridPoint pixel_of(const vector2<double> &p)
+{
+    return {int64_t(std::floor(p.x + 0.5)), int64_t(std::floor(p.y + 0.5))};
+}
+
+// hot pixels grouped by row, rows in decreasing order
+class HotPixels
+{
+  public:
+    // rows must come in nonincreasing order, as the sweep reports them
+    void add(const GridPoint &pixel)
+    {
+        if (rows.empty() || rows.back() != pixel.y)
+        {
+            assert((rows.empty() || pixel.y < rows.back()) && "rows out of order");
+            rows.push_back(pixel.y);
+            offsets.push_back(columns.size());
+        }
+        columns.push_back(pixel.x);
+    }
+
+    // sort and deduplicate the columns of every row
+    void finish()
+    {
+        offsets.push_back(columns.size());
+        auto compacted = std::vector<int64_t>();
+        compacted.reserve(columns.size());
+        for (size_t r = 0; r < rows.size(); ++r)
+        {
+            auto first = columns.begin() + offsets[r];
+            auto last = columns.begin() + offsets[r + 1];
+            std::sort(first, last);
+            offsets[r] = compacted.size();
+            std::unique_copy(first, last, std::back_inserter(compacted));
+        }
+        offsets.back() = compacted.size();
+        columns.swap(compacted);
+    }
+
+    size_t size() const
+    {
+        return columns.size();
+    }
+
+    // visit the hot pixels crossed by the segment pq, in grid units
+    template <class Visitor>
+    void crossed_by(const vector2<double> &p, const vector2<double> &q, Visitor &&visit) const
+    {
+        auto low = std::min(p.y, q.y), high = std::max(p.y, q.y);
+        // rows are descending, first row not above the segment
+        auto r = size_t(std::lower_bound(rows.begin(), rows.end(), int64_t(std::floor(high + 0.5)),
+                                         [](int64_t a, int64_t b) { return a > b; }) -
+                        rows.begin());
+        for (; r < rows.size() && rows[r] + 0.5 >= low; ++r)
+        {
+            // x range of the segment inside the row
+            auto y0 = std::max(low, rows[r] - 0.5), y1 = std::min(high, rows[r] + 0.5);
+            double x0, x1;
+            if (p.y == q.y)
+            {
+                x0 = p.x;
+                x1 = q.x;
+            }
+            else
+            {
+                x0 = p.x + (q.x - p.x) * (y0 - p.y) / (q.y - p.y);
+                x1 = p.x + (q.x - p.x) * (y1 - p.y) / (q.y - p.y);
+            }
+            if (x1 < x0)
+            {
+                std::swap(x0, x1);
+            }
+            auto first = columns.begin() + offsets[r];
+            auto last = columns.begin() + offsets[r + 1];
+            for (auto it = std::lower_bound(first, last, int64_t(std::ceil(x0 - 0.5)));
+                 it != last && *it - 0.5 <= x1; ++it)
+            {
+                visit(GridPoint(*it, rows[r]));
+            }
+        }
+    }
+
+  private:
+    std::vector<int64_t> rows;
+    std::vector<size_t> offsets;
+    std::vector<int64_t> columns;
+};
+
+// Snap round the segments with the given pixel size, returns one polyline
+// of pixel centers per segment (in grid units).
+template <class Kernel>
+std::vector<std::vector<GridPoint>> snap_round(const std::vector<Segment<Kernel>> &segments, double pixel_size)
+{
+    auto to_grid = [pixel_size](const vector2<double> &p) {
+        return vector2<double>(p.x / pixel_size, p.y / pixel_size);
+    };
+
+    // hot pixels, found in sweep order
+    auto hot_pixels = HotPixels();
+    sweep_line(segments, [&](const auto &point, const auto &, const auto &) {
+        hot_pixels.add(pixel_of(to_grid(Kernel::to_double(point))));
+    });
+    hot_pixels.finish();
+
+    // hot pixels crossed by pq other than its ends, ordered from p to q
+    auto route = [&hot_pixels](const vector2<double> &p, const vector2<double> &q,
+                               const GridPoint &from, const GridPoint &to) {
+        auto crossed = std::vector<GridPoint>();
+        hot_pixels.crossed_by(p, q, [&](const GridPoint &pixel) {
+            if (pixel != from && pixel != to)
+            {
+                crossed.push_back(pixel);
+            }
+        });
+        auto d = q - p;
+        std::sort(crossed.begin(), crossed.end(), [&](const GridPoint &a, const GridPoint &b) {
+            return dot(vector2<double>(a.x, a.y) - p, d) < dot(vector2<double>(b.x, b.y) - p, d);
+        });
+        return crossed;
+    };
+
+    auto result = std::vector<std::vector<GridPoint>>();
+    result.reserve(segments.size());
+    for (const auto &segment : segments)
+    {
+        auto p = to_grid(Kernel::to_double(segment.a));
+        auto q = to_grid(Kernel::to_double(segment.b));
+        auto polyline = std::vector<GridPoint>{pixel_of(p)};
+        for (auto pixel : route(p, q, pixel_of(p), pixel_of(q)))
+        {
+            polyline.push_back(pixel);
+        }
+        if (pixel_of(q) != pixel_of(p))
+        {
+            polyline.push_back(pixel_of(q));
+        }
+
+        // iterate on the fragments between consecutive centers
+        auto snapped = std::vector<GridPoint>{polyline.front()};
+        auto pending = std::vector<GridPoint>(polyline.rbegin(), polyline.rend() - 1);
+        while (!pending.empty())
+        {
+            auto from = snapped.back();
+            auto to = pending.back();
+            auto crossed = route(vector2<double>(from.x, from.y), vector2<double>(to.x, to.y), from, to);
+            if (crossed.empty())
+            {
+                snapped.push_back(to);
+                pending.pop_back();
+            }
+            else
+            {
+                pending.insert(pending.end(), crossed.rbegin(), crossed.rend());
+            }
+        }
+        result.push_back(std::move(snapped));
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,735 @@
+#ifndef SWEEP_LINE_HPP
+#define SWEEP_LINE_HPP
+
+#include <set>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+
+#include "kernel.hpp"
+
+template <class Kernel>
+struct Segment
+{
+    using Point = typename Kernel::Point;
+    using EventPoint = typename Kernel::EventPoint;
+
+    Point a, b;
+
+    EventPoint key{}; // compare point
+
+    size_t id = 0; // index in the input, assigned by the sweep
+
+    // index of the segment continuing this one downwards in a monotone
+    // chain (see monotone_chains), none otherwise
+    size_t next = size_t(-1);
+
+    Point &upper_endpoint()
+    {
+        return vertically_less(a, b) ? b : a;
+    }
+
+    const Point &upper_endpoint() const
+    {
+        return vertically_less(a, b) ? b : a;
+    }
+
+    Point &lower_endpoint()
+    {
+        return vertically_less(a, b) ? a : b;
+    }
+
+    const Point &lower_endpoint() const
+    {
+        return vertically_less(a, b) ? a : b;
+    }
+
+    Point direction() const
+    {
+        return b - a;
+    }
+};
+
+// type of the input coordinates
+template <class Kernel>
+using Coordinate = std::decay_t<decltype(std::declval<typename Kernel::Point>().x)>;
+
+// closed polygonal chain, the last vertex connects back to the first
+template <class Kernel>
+using Ring = std::vector<typename Kernel::Point>;
+
+// How the sweep reads its input: segment i of a random access range, read
+// in place. This one reads ranges of Segment; specialize it for other
+// layouts, e.g. separate arrays of coordinates, with the same members.
+template <class Range>
+struct SegmentTraits
+{
+  private:
+    template <class Kernel>
+    static Kernel kernel_of(const ::Segment<Kernel> &);
+
+  public:
+    using Kernel = decltype(kernel_of(std::declval<const Range &>()[0]));
+    using Point = typename Kernel::Point;
+
+    static size_t size(const Range &range)
+    {
+        return range.size();
+    }
+
+    static const Point &a(const Range &range, size_t i)
+    {
+        return range[i].a;
+    }
+
+    static const Point &b(const Range &range, size_t i)
+    {
+        return range[i].b;
+    }
+
+    // see Segment::next
+    static size_t next(const Range &range, size_t i)
+    {
+        return range[i].next;
+    }
+};
+
+// Links the segments of a polyline from first on, each starting where the
+// one before it ends, into monotone chains: consecutive segments going the
+// same way vertically continue each other, so that a chain takes a single
+// slot in the status as the sweep moves along it.
+template <class Kernel>
+void link_monotone_chains(std::vector<Segment<Kernel>> &segments, size_t first)
+{
+    for (size_t i = first; i + 1 < segments.size(); ++i)
+    {
+        auto &s = segments[i], &t = segments[i + 1];
+        if (s.a == s.b || t.a == t.b)
+        {
+            continue;
+        }
+        auto down = vertically_less(s.b, s.a);
+        if (down == vertically_less(t.b, t.a))
+        {
+            // the sweep goes from the upper segment to the lower one
+            (down ? s.next : t.next) = down ? i + 1 : i;
+        }
+    }
+}
+
+// the segments of the polylines, linked into monotone chains
+template <class Kernel>
+std::vector<Segment<Kernel>> monotone_chains(const std::vector<std::vector<typename Kernel::Point>> &polylines)
+{
+    auto segments = std::vector<Segment<Kernel>>();
+    for (const auto &polyline : polylines)
+    {
+        auto first = segments.size();
+        for (size_t i = 0; i + 1 < polyline.size(); ++i)
+        {
+            segments.push_back({polyline[i], polyline[i + 1]});
+        }
+        link_monotone_chains(segments, first);
+    }
+    return segments;
+}
+
+template <class Kernel>
+bool same_segment(const Segment<Kernel> &s1, const Segment<Kernel> &s2)
+{
+    return s1.id == s2.id;
+}
+
+// proper crossings only: an endpoint touching the other segment is
+// already an event point, and a rounded copy of it could fall below it
+template <class Kernel>
+bool crosses(const Segment<Kernel> &s1, const Segment<Kernel> &s2)
+{
+    auto side = [](const typename Kernel::Point &p, const Segment<Kernel> &s) {
+        return Kernel::orientation(s.a, s.b, p);
+    };
+    return side(s1.a, s2) * side(s1.b, s2) < 0 && side(s2.a, s1) * side(s2.b, s1) < 0;
+}
+
+template <class Kernel>
+std::shared_ptr<typename Kernel::EventPoint> intersection(const Segment<Kernel> &s1, const Segment<Kernel> &s2)
+{
+    using EventPoint = typename Kernel::EventPoint;
+
+    auto ptr = std::shared_ptr<EventPoint>(nullptr);
+
+    if (crosses(s1, s2))
+    {
+        ptr = std::make_shared<EventPoint>(Kernel::intersection_point(s1.a, s1.b, s2.a, s2.b));
+    }
+
+    return ptr;
+}
+
+template <class Kernel>
+struct Crossing
+{
+    size_t first, second;
+    typename Kernel::EventPoint point;
+};
+
+// intersection() over a block of candidate pairs of segments, given by
+// index, appending the crossing ones
+template <class Kernel>
+void intersections(const std::vector<Segment<Kernel>> &segments,
+                   const std::vector<std::pair<size_t, size_t>> &pairs,
+                   std::vector<Crossing<Kernel>> &crossings)
+{
+    for (const auto &pair : pairs)
+    {
+        const auto &s1 = segments[pair.first], &s2 = segments[pair.second];
+        if (crosses(s1, s2))
+        {
+            crossings.push_back({pair.first, pair.second, Kernel::intersection_point(s1.a, s1.b, s2.a, s2.b)});
+        }
+    }
+}
+
+template <class Kernel>
+struct Event
+{
+    enum class Type
+    {
+        upper,
+        lower,
+        intersection,
+    };
+    typename Kernel::EventPoint point;
+    Type type;
+    Segment<Kernel> segment;
+};
+
+// Order of the segments on the sweep line. Each segment carries the point
+// where it was (re)inserted, the most recent key is located against the
+// other segment, and segments through the same point are ordered by their
+// direction just below it.
+template <class Kernel>
+struct StatusLess
+{
+    bool operator()(const Segment<Kernel> &s1, const Segment<Kernel> &s2) const
+    {
+        auto below = [](const Segment<Kernel> &s1, const Segment<Kernel> &s2) {
+            return Kernel::orientation(s1.upper_endpoint(), s1.lower_endpoint(),
+                                       s2.upper_endpoint(), s2.lower_endpoint()) > 0;
+        };
+
+        if (Kernel::equal(s1.key, s2.key))
+        {
+            return below(s1, s2);
+        }
+
+        if (!Kernel::vertically_less(s2.key, s1.key))
+        {
+            auto side = Kernel::orientation(s2.upper_endpoint(), s2.lower_endpoint(), s1.key);
+            if (side != 0)
+            {
+                return side < 0;
+            }
+        }
+        else
+        {
+            auto side = Kernel::orientation(s1.upper_endpoint(), s1.lower_endpoint(), s2.key);
+            if (side != 0)
+            {
+                return side > 0;
+            }
+        }
+        return below(s1, s2);
+    }
+};
+
+template <class Kernel>
+using Status = std::multiset<Segment<Kernel>, StatusLess<Kernel>>;
+
+// the range of the status segments passing through the point
+template <class Kernel>
+auto segments_through(const Status<Kernel> &status, const typename Kernel::EventPoint &point)
+{
+    // degenerate segment, equivalent to every segment through the point
+    const auto key_segment = Segment<Kernel>{
+        typename Kernel::Point(0, 0),
+        typename Kernel::Point(0, 0),
+        point,
+        size_t(-1)};
+    return std::make_pair(status.lower_bound(key_segment), status.upper_bound(key_segment));
+}
+
+// segment i of the input with its index as id, keyed at its upper endpoint
+template <class Segments>
+auto input_segment(const Segments &segments, size_t i)
+{
+    using Traits = SegmentTraits<Segments>;
+    using Kernel = typename Traits::Kernel;
+    auto segment = Segment<Kernel>{Traits::a(segments, i), Traits::b(segments, i)};
+    segment.id = i;
+    segment.key = Kernel::to_event_point(segment.upper_endpoint());
+    segment.next = Traits::next(segments, i);
+    return segment;
+}
+
+// whether each segment continues a monotone chain; a chain only starts
+// with its first segment, the others are queued as the sweep gets to them
+template <class Segments>
+std::vector<bool> continued_segments(const Segments &segments)
+{
+    using Traits = SegmentTraits<Segments>;
+    auto continued = std::vector<bool>(Traits::size(segments), false);
+    for (size_t i = 0; i < continued.size(); ++i)
+    {
+        auto next = Traits::next(segments, i);
+        if (next != size_t(-1))
+        {
+            continued[next] = true;
+        }
+    }
+    return continued;
+}
+
+// The endpoint events of the input in sweep order, sorted in memory as
+// indices: endpoint e is the upper endpoint of segment e / 2 if e is even,
+// the lower one otherwise.
+template <class Segments>
+class SortedEndpoints
+{
+  public:
+    using Traits = SegmentTraits<Segments>;
+    using Kernel = typename Traits::Kernel;
+
+    explicit SortedEndpoints(const Segments &segments) : segments(segments)
+    {
+        auto continued = continued_segments(segments);
+        endpoints.reserve(2 * continued.size());
+        for (size_t i = 0; i < continued.size(); ++i)
+        {
+            if (!continued[i])
+            {
+                endpoints.push_back(2 * i);
+                endpoints.push_back(2 * i + 1);
+            }
+        }
+        // the next one at the back
+        std::sort(endpoints.begin(), endpoints.end(), [this](size_t e1, size_t e2) {
+            return vertically_less(endpoint(e1), endpoint(e2));
+        });
+    }
+
+    bool empty() const
+    {
+        return endpoints.empty();
+    }
+
+    typename Kernel::EventPoint point() const
+    {
+        return Kernel::to_event_point(endpoint(endpoints.back()));
+    }
+
+    bool upper() const
+    {
+        return endpoints.back() % 2 == 0;
+    }
+
+    Segment<Kernel> segment() const
+    {
+        return input_segment(segments, endpoints.back() / 2);
+    }
+
+    void pop()
+    {
+        endpoints.pop_back();
+    }
+
+  private:
+    typename Kernel::Point endpoint(size_t e) const
+    {
+        const auto &a = Traits::a(segments, e / 2), &b = Traits::b(segments, e / 2);
+        return vertically_less(a, b) == (e % 2 == 0) ? b : a;
+    }
+
+    const Segments &segments;
+    std::vector<size_t> endpoints;
+};
+
+// The events found during the sweep, intersections and the lower
+// endpoints of segments continuing monotone chains, the next one on top.
+template <class Kernel>
+class EventQueue
+{
+  public:
+    using Event = ::Event<Kernel>;
+
+    bool empty() const
+    {
+        return events.empty();
+    }
+
+    size_t size() const
+    {
+        return events.size();
+    }
+
+    const Event &top() const
+    {
+        return *events.rbegin();
+    }
+
+    void pop()
+    {
+        events.erase(std::prev(events.end()));
+    }
+
+    void insert(const Event &event)
+    {
+        events.insert(event);
+    }
+
+    // an intersection event, unless the segment already has one there
+    void insert_once(const Event &event)
+    {
+        auto range = events.equal_range(event);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->type == Event::Type::intersection && same_segment(it->segment, event.segment))
+            {
+                return;
+            }
+        }
+        events.insert(event);
+    }
+
+    // removes the count events the sweep gets to last, returned in sweep
+    // order
+    std::vector<Event> take_last(size_t count)
+    {
+        auto last = std::next(events.begin(), std::min(count, events.size()));
+        auto taken = std::vector<Event>(std::make_reverse_iterator(last), events.rend());
+        events.erase(events.begin(), last);
+        return taken;
+    }
+
+  private:
+    struct VerticallyLess
+    {
+        bool operator()(const Event &a, const Event &b) const
+        {
+            return Kernel::vertically_less(a.point, b.point);
+        }
+    };
+
+    std::multiset<Event, VerticallyLess> events;
+};
+
+// One step of sweep_line: handles the events at the next point, status
+// being the sweep line so far, then calls the observer. False if the
+// observer stops the sweep.
+template <class Segments, class Endpoints, class Events, class Observer>
+bool sweep_next_point(const Segments &segments, Endpoints &endpoints, Events &events,
+                      Status<typename SegmentTraits<Segments>::Kernel> &status, Observer &&observer)
+{
+    using Traits = SegmentTraits<Segments>;
+    using Kernel = typename Traits::Kernel;
+    using Point = typename Kernel::EventPoint;
+    using Segment = ::Segment<Kernel>;
+    using Event = ::Event<Kernel>;
+
+    auto events_at_next_point = [&]() {
+        auto result_events = std::vector<Event>();
+        auto point = !endpoints.empty() && (events.empty() || Kernel::vertically_less(events.top().point,
+                                                                                      endpoints.point()))
+                         ? endpoints.point()
+                         : events.top().point;
+        // there may be more than 1 event at this point
+        while (!endpoints.empty() && Kernel::equal(endpoints.point(), point))
+        {
+            result_events.push_back({point, endpoints.upper() ? Event::Type::upper : Event::Type::lower,
+                                     endpoints.segment()});
+            endpoints.pop();
+        }
+        while (!events.empty() && Kernel::equal(events.top().point, point))
+        {
+            // a queue spilling to disk may have an intersection event twice
+            auto event = events.top();
+            events.pop();
+            if (event.type != Event::Type::intersection ||
+                std::none_of(result_events.begin(), result_events.end(), [&event](const Event &other) {
+                    return other.type == Event::Type::intersection && same_segment(other.segment, event.segment);
+                }))
+            {
+                result_events.push_back(event);
+            }
+        }
+        return result_events;
+    }();
+
+    const auto point = events_at_next_point.front().point;
+
+    const auto event_filter = [&events_at_next_point](typename Event::Type type) {
+        auto result_events = std::vector<Event>();
+        for (const auto &event : events_at_next_point)
+        {
+            if (event.type == type)
+            {
+                result_events.push_back(event);
+            }
+        }
+        return result_events;
+    };
+    const auto contains = [](const std::vector<Event> &events, const Segment &segment) {
+        for (const auto &event : events)
+        {
+            if (same_segment(event.segment, segment))
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+    // a segment that starts and ends here never enters the status
+    const auto except = [&contains](std::vector<Event> events, const std::vector<Event> &other) {
+        events.erase(std::remove_if(events.begin(), events.end(), [&](const Event &event) {
+                         return contains(other, event.segment);
+                     }),
+                     events.end());
+        return events;
+    };
+    const auto upper_events = except(event_filter(Event::Type::upper), event_filter(Event::Type::lower));
+    const auto lower_events = except(event_filter(Event::Type::lower), event_filter(Event::Type::upper));
+    // the segments continuing a monotone chain from here, their lower
+    // events are only queued now
+    const auto chain_events = [&]() {
+        auto result_events = std::vector<Event>();
+        for (const auto &event : lower_events)
+        {
+            if (event.segment.next != size_t(-1))
+            {
+                auto segment = input_segment(segments, event.segment.next);
+                events.insert({
+                    Kernel::to_event_point(segment.lower_endpoint()),
+                    Event::Type::lower,
+                    segment,
+                });
+                result_events.push_back({point, Event::Type::upper, segment});
+                events_at_next_point.push_back(result_events.back());
+            }
+        }
+        return result_events;
+    }();
+    const auto intersection_events = [&]() {
+        // a segment ending at this point is not crossing it
+        auto result_events = std::vector<Event>();
+        for (const auto &event : event_filter(Event::Type::intersection))
+        {
+            if (!contains(upper_events, event.segment) &&
+                !contains(lower_events, event.segment) &&
+                !contains(result_events, event.segment))
+            {
+                result_events.push_back(event);
+            }
+        }
+        // segments through an endpoint of another one have no event of
+        // their own here, they are found on the sweep line
+        const auto through = segments_through(status, point);
+        for (auto it = through.first; it != through.second; ++it)
+        {
+            if (!contains(lower_events, *it) && !contains(result_events, *it))
+            {
+                result_events.push_back({point, Event::Type::intersection, *it});
+                events_at_next_point.push_back(result_events.back());
+            }
+        }
+        return result_events;
+    }();
+
+    // delete and insert/re-insert the segments into status
+    {
+        const auto find_in_status = [&status, &point](const Segment &s1) {
+            // the segment passes through this point, so search outwards from
+            // there, rounded intersection points may be off by a few places
+            auto left = segments_through(status, point).first;
+            auto right = left;
+            while (left != status.begin() || right != status.end())
+            {
+                if (right != status.end())
+                {
+                    if (same_segment(s1, *right))
+                    {
+                        return right;
+                    }
+                    ++right;
+                }
+                if (left != status.begin())
+                {
+                    --left;
+                    if (same_segment(s1, *left))
+                    {
+                        return left;
+                    }
+                }
+            }
+            return status.end();
+        };
+
+        const auto remove_event_segment_from_status = [&status, &find_in_status](const std::vector<Event> &events) {
+            for (const auto &event : events)
+            {
+                auto it = find_in_status(event.segment);
+                assert(it != status.end() && "erase failed!");
+                status.erase(it);
+            }
+        };
+
+        const auto insert_event_segment_to_status = [&status, &point](const std::vector<Event> &events) {
+            for (auto event : events)
+            {
+                event.segment.key = point;
+                status.insert(event.segment);
+            }
+        };
+
+        if (chain_events.size() == 1 && lower_events.size() == 1 &&
+            upper_events.empty() && intersection_events.empty())
+        {
+            // nothing else meets the chain here, so its next segment takes
+            // over the slot: the node is reused and inserted back with its
+            // old successor as the hint, which only takes the comparisons
+            // checking the hint instead of a search from the root; finding
+            // the node is still a search
+            auto it = find_in_status(lower_events.front().segment);
+            assert(it != status.end() && "chain not found!");
+            auto hint = std::next(it);
+            auto node = status.extract(it);
+            node.value() = chain_events.front().segment;
+            node.value().key = point;
+            status.insert(hint, std::move(node));
+        }
+        else
+        {
+            remove_event_segment_from_status(lower_events);
+            remove_event_segment_from_status(intersection_events);
+
+            insert_event_segment_to_status(intersection_events);
+            insert_event_segment_to_status(upper_events);
+            insert_event_segment_to_status(chain_events);
+        }
+    }
+
+    // update intersection in the new status
+    {
+        const auto append_new_event = [&events](const Segment &l, const Segment &r, const Point &pt) {
+            // if the intersection point is under pt, register this event
+            auto ptr = intersection(l, r);
+            if (ptr != nullptr)
+            {
+                auto int_pt = *ptr;
+                if (Kernel::vertically_less(int_pt, pt))
+                {
+                    events.insert_once({int_pt, Event::Type::intersection, l});
+                    events.insert_once({int_pt, Event::Type::intersection, r});
+                }
+            }
+        };
+        const auto through = segments_through(status, point);
+        const auto lower_it = through.first;
+        const auto upper_it = through.second;
+        if (lower_it == upper_it)
+        {
+            // only leaving segments
+            if (lower_it != status.begin() && upper_it != status.end())
+            {
+                append_new_event(*std::prev(lower_it), *upper_it, point);
+            }
+        }
+        else
+        {
+            if (lower_it != status.begin())
+            {
+                append_new_event(*std::prev(lower_it), *lower_it, point);
+            }
+            if (upper_it != status.end())
+            {
+                append_new_event(*std::prev(upper_it), *upper_it, point);
+            }
+        }
+    }
+
+    if constexpr (std::is_same<decltype(observer(point, events_at_next_point, status)), bool>::value)
+    {
+        return observer(point, events_at_next_point, status);
+    }
+    else
+    {
+        observer(point, events_at_next_point, status);
+        return true;
+    }
+}
+
+// Bentley-Ottmann sweep from top to bottom over a range of segments read
+// through SegmentTraits, observer(point, events, status) is called once
+// every event point has been handled. An observer returning bool stops the
+// sweep by returning false.
+//
+// The endpoint events come from endpoints, in sweep order: empty(), then
+// point(), upper() and segment() of the next one, and pop() (e.g.
+// SortedEndpoints). Only the segments continuing monotone chains are read
+// from the input by the sweep itself. The events found on the way go to
+// events, with the members of EventQueue.
+template <class Segments, class Endpoints, class Events, class Observer>
+void sweep_line(const Segments &segments, Endpoints &endpoints, Events &events, Observer &&observer)
+{
+    auto status = Status<typename SegmentTraits<Segments>::Kernel>();
+    while ((!endpoints.empty() || !events.empty()) && sweep_next_point(segments, endpoints, events, status, observer))
+    {
+    }
+}
+
+// the sweep with the endpoints sorted in memory; the input is never
+// copied, a segment is only read into a Segment when the sweep line
+// reaches it
+template <class Segments, class Observer>
+void sweep_line(const Segments &segments, Observer &&observer)
+{
+    auto endpoints = SortedEndpoints<Segments>(segments);
+    auto events = EventQueue<typename SegmentTraits<Segments>::Kernel>();
+    sweep_line(segments, endpoints, events, observer);
+}
+
+template <class Segments>
+void sweep_line(const Segments &segments)
+{
+    sweep_line(segments, [](const auto &...) {});
+}
+
+// Calls visit(i, j) for the pairs of segment ids i < j among the events of
+// a point where more than one segment meets, as count_intersections counts
+// them.
+template <class Event, class Visitor>
+void meeting_pairs(const std::vector<Event> &events, std::vector<size_t> &ids, Visitor &&visit)
+{
+    if (events.size() < 2)
+    {
+        return;
+    }
+    ids.clear();
+    for (const auto &event : events)
+    {
+        ids.push_back(event.segment.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    for (size_t k = 0; k < ids.size(); ++k)
+    {
+        for (size_t l = k + 1; l < ids.size(); ++l)
+        {
+            visit(ids[k], ids[l]);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,348 @@
+#ifndef TILING_HPP
+#define TILING_HPP
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include "sweep_line.hpp"
+#include "parallel.hpp"
+#include "intersection_file.hpp"
+
+// Intersections by independent sweeps over the tiles of a grid. A segment
+// goes to every tile its bounding box touches, grown by a halo, and each
+// tile is swept on its own. A point is reported by the tile it lies in,
+// the same tile function deciding both, so that every segment through a
+// point is in the tile reporting it and no other tile reports it. The halo
+// covers the error of intersection points computed slightly off their
+// segments, the point_error of the kernel.
+
+// segments i < j of the input meeting at point
+template <class Kernel>
+struct IntersectionRecord
+{
+    typename Kernel::EventPoint point;
+    size_t i, j;
+};
+
+// columns x rows tiles over a box
+struct TileGrid
+{
+    double x0, y0, width, height;
+    size_t columns, rows;
+
+    size_t size() const
+    {
+        return columns * rows;
+    }
+
+    size_t column(double x) const
+    {
+        return cell(x, x0, width, columns);
+    }
+
+    size_t row(double y) const
+    {
+        return cell(y, y0, height, rows);
+    }
+
+    size_t tile(const vector2<double> &p) const
+    {
+        return row(p.y) * columns + column(p.x);
+    }
+
+  private:
+    // monotone in value, clamped to the grid
+    static size_t cell(double value, double origin, double extent, size_t count)
+    {
+        auto c = std::floor((value - origin) / extent * count);
+        return !(extent > 0) || c <= 0 ? 0 : std::min(count - 1, size_t(std::min(c, double(count))));
+    }
+};
+
+// the grid over the bounding box of the segments
+template <class Segments>
+TileGrid tile_grid(const Segments &segments, size_t columns, size_t rows)
+{
+    using Traits = SegmentTraits<Segments>;
+    using Kernel = typename Traits::Kernel;
+
+    if (columns == 0 || rows == 0)
+    {
+        throw std::invalid_argument("a grid has at least one tile");
+    }
+    auto inf = std::numeric_limits<double>::infinity();
+    double xlo = inf, ylo = inf, xhi = -inf, yhi = -inf;
+    for (size_t i = 0; i < Traits::size(segments); ++i)
+    {
+        for (const auto &p : {Kernel::to_double(Traits::a(segments, i)), Kernel::to_double(Traits::b(segments, i))})
+        {
+            xlo = std::min(xlo, p.x);
+            ylo = std::min(ylo, p.y);
+            xhi = std::max(xhi, p.x);
+            yhi = std::max(yhi, p.y);
+        }
+    }
+    if (xlo > xhi)
+    {
+        return {0, 0, 0, 0, columns, rows};
+    }
+    return {xlo, ylo, xhi - xlo, yhi - ylo, columns, rows};
+}
+
+// The segments of one tile, by their indices in the input in increasing
+// order, read in place through SegmentTraits. Monotone chains are kept
+// where the next segment is in the tile too.
+template <class Segments>
+struct TileSegments
+{
+    const Segments *segments;
+    const std::vector<size_t> *indices;
+};
+
+template <class Segments>
+struct SegmentTraits<TileSegments<Segments>>
+{
+    using Input = SegmentTraits<Segments>;
+    using Kernel = typename Input::Kernel;
+    using Point = typename Kernel::Point;
+
+    static size_t size(const TileSegments<Segments> &tile)
+    {
+        return tile.indices->size();
+    }
+
+    static decltype(auto) a(const TileSegments<Segments> &tile, size_t i)
+    {
+        return Input::a(*tile.segments, (*tile.indices)[i]);
+    }
+
+    static decltype(auto) b(const TileSegments<Segments> &tile, size_t i)
+    {
+        return Input::b(*tile.segments, (*tile.indices)[i]);
+    }
+
+    static size_t next(const TileSegments<Segments> &tile, size_t i)
+    {
+        auto next = Input::next(*tile.segments, (*tile.indices)[i]);
+        if (next == size_t(-1))
+        {
+            return next;
+        }
+        auto it = std::lower_bound(tile.indices->begin(), tile.indices->end(), next);
+        return it != tile.indices->end() && *it == next ? size_t(it - tile.indices->begin()) : size_t(-1);
+    }
+};
+
+namespace tiling
+{
+// by default Kernel::point_error of the largest coordinate of the box,
+// twice over
+template <class Kernel>
+double halo(const TileGrid &grid, double halo)
+{
+    if (halo >= 0)
+    {
+        return halo;
+    }
+    auto magnitude = std::max({std::abs(grid.x0), std::abs(grid.y0), std::abs(grid.x0 + grid.width),
+                               std::abs(grid.y0 + grid.height)});
+    return 2 * Kernel::point_error * magnitude;
+}
+
+// the lists of the tiles in rows [first_row, last_row], by a scan of the
+// input
+template <class Segments>
+std::vector<std::vector<size_t>> tile_segments(const Segments &segments, const TileGrid &grid, double halo,
+                                               size_t first_row, size_t last_row)
+{
+    using Traits = SegmentTraits<Segments>;
+    using Kernel = typename Traits::Kernel;
+
+    halo = tiling::halo<Kernel>(grid, halo);
+    auto tiles = std::vector<std::vector<size_t>>((last_row - first_row + 1) * grid.columns);
+    for (size_t i = 0; i < Traits::size(segments); ++i)
+    {
+        auto a = Kernel::to_double(Traits::a(segments, i)), b = Kernel::to_double(Traits::b(segments, i));
+        auto low = grid.row(std::min(a.y, b.y) - halo), high = grid.row(std::max(a.y, b.y) + halo);
+        if (high < first_row || low > last_row)
+        {
+            continue;
+        }
+        auto first_column = grid.column(std::min(a.x, b.x) - halo);
+        auto last_column = grid.column(std::max(a.x, b.x) + halo);
+        for (auto row = std::max(low, first_row); row <= std::min(high, last_row); ++row)
+        {
+            for (auto column = first_column; column <= last_column; ++column)
+            {
+                tiles[(row - first_row) * grid.columns + column].push_back(i);
+            }
+        }
+    }
+    return tiles;
+}
+} // namespace tiling
+
+// The input indices of the segments of every tile, in increasing order,
+// all built in one pass: a size_t per segment and tile it goes to, n times
+// the replication, which grows as the tiles get smaller against the
+// segments; tiled_intersections builds a row of tiles at a time instead.
+// The halo is in input units, by default Kernel::point_error of the
+// largest coordinate of the box, twice over.
+template <class Segments>
+std::vector<std::vector<size_t>> tile_segments(const Segments &segments, const TileGrid &grid, double halo = -1)
+{
+    return tiling::tile_segments(segments, grid, halo, 0, grid.rows - 1);
+}
+
+// The input indices of the segments of the tiles of a row, by column, as
+// tile_segments has them; the input is scanned once per row.
+template <class Segments>
+std::vector<std::vector<size_t>> row_segments(const Segments &segments, const TileGrid &grid, size_t row,
+                                              double halo = -1)
+{
+    return tiling::tile_segments(segments, grid, halo, row, row);
+}
+
+// Calls visit(record) with the intersection records of tile t, by input
+// indices and in sweep order, indices being the segments of the tile.
+template <class Segments, class Visitor>
+void sweep_tile(const Segments &segments, const TileGrid &grid, size_t t, const std::vector<size_t> &indices,
+                Visitor &&visit)
+{
+    using Kernel = typename SegmentTraits<Segments>::Kernel;
+
+    auto ids = std::vector<size_t>();
+    sweep_line(TileSegments<Segments>{&segments, &indices},
+               [&](const auto &point, const auto &events, const auto &) {
+                   if (events.size() < 2 || grid.tile(Kernel::to_double(point)) != t)
+                   {
+                       return;
+                   }
+                   meeting_pairs(events, ids, [&](size_t i, size_t j) {
+                       visit(IntersectionRecord<Kernel>{point, indices[i], indices[j]});
+                   });
+               });
+}
+
+// Calls visit(row, records) with the intersection records of each row of
+// tiles, from the top row down, in sweep order within the row, so that
+// the records of all the calls are in sweep order. A row is done at a
+// time: the index lists of its tiles are built when it comes up
+// (row_segments), its tiles are swept concurrently and their records
+// merged; only the lists and records of one row are held. visit is called
+// from the calling thread.
+template <class Segments, class Visitor>
+void tiled_intersections(const Segments &segments, const TileGrid &grid, Visitor &&visit, double halo = -1)
+{
+    using Kernel = typename SegmentTraits<Segments>::Kernel;
+    using Record = IntersectionRecord<Kernel>;
+
+    // the rows of the grid go up, the sweep goes down
+    for (auto row = grid.rows; row-- > 0;)
+    {
+        auto tiles = row_segments(segments, grid, row, halo);
+        auto records = std::vector<std::vector<Record>>(grid.columns);
+        parallel_for(
+            grid.columns,
+            [&](size_t first, size_t last) {
+                for (auto column = first; column < last; ++column)
+                {
+                    sweep_tile(segments, grid, row * grid.columns + column, tiles[column],
+                               [&tile = records[column]](const Record &record) { tile.push_back(record); });
+                    tiles[column] = {};
+                }
+            },
+            1);
+
+        // the columns merged by a heap of their next records, the highest
+        // on top; ties keep the column order
+        auto size = size_t(0), merged = std::vector<Record>();
+        auto next = std::vector<size_t>(grid.columns, 0), heap = std::vector<size_t>();
+        for (size_t column = 0; column < grid.columns; ++column)
+        {
+            size += records[column].size();
+            if (!records[column].empty())
+            {
+                heap.push_back(column);
+            }
+        }
+        auto lower = [&](size_t c1, size_t c2) {
+            const auto &p1 = records[c1][next[c1]].point, &p2 = records[c2][next[c2]].point;
+            return Kernel::vertically_less(p1, p2) || (!Kernel::vertically_less(p2, p1) && c1 > c2);
+        };
+        std::make_heap(heap.begin(), heap.end(), lower);
+        merged.reserve(size);
+        while (!heap.empty())
+        {
+            std::pop_heap(heap.begin(), heap.end(), lower);
+            auto column = heap.back();
+            merged.push_back(records[column][next[column]++]);
+            if (next[column] == records[column].size())
+            {
+                heap.pop_back();
+                records[column] = {};
+            }
+            else
+            {
+                std::push_heap(heap.begin(), heap.end(), lower);
+            }
+        }
+        visit(row, std::move(merged));
+    }
+}
+
+// The intersection records of all tiles into one file in sweep order, a
+// row of tiles at a time as each is swept: lines of x,y,i,j for a .csv
+// path, a delta encoded intersection file otherwise. Returns the number of
+// records.
+template <class Segments>
+size_t write_tiled_intersections(const Segments &segments, const TileGrid &grid, const std::string &path,
+                                 double halo = -1)
+{
+    using Kernel = typename SegmentTraits<Segments>::Kernel;
+
+    size_t count = 0;
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0)
+    {
+        auto output = std::ofstream(path);
+        output.precision(17);
+        tiled_intersections(
+            segments, grid,
+            [&](size_t, std::vector<IntersectionRecord<Kernel>> &&records) {
+                for (const auto &record : records)
+                {
+                    auto p = Kernel::to_double(record.point);
+                    output << p.x << "," << p.y << "," << record.i << "," << record.j << "\n";
+                }
+                count += records.size();
+            },
+            halo);
+        output.close();
+        if (!output)
+        {
+            throw std::runtime_error("cannot write " + path);
+        }
+        return count;
+    }
+
+    auto writer = IntersectionFileWriter(path);
+    tiled_intersections(
+        segments, grid,
+        [&](size_t, std::vector<IntersectionRecord<Kernel>> &&records) {
+            for (const auto &record : records)
+            {
+                writer.add(Kernel::to_double(record.point), record.i, record.j);
+            }
+        },
+        halo);
+    writer.finish();
+    return writer.size();
+}
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef TRIANGULATION_HPP
+#define TRIANGULATION_HPP
+
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+
+#include "sweep_line.hpp"
+#include "dcel.hpp"
+
+// Triangulation of polygons with holes in two passes. A sweep from top to
+// bottom adds the diagonals that split the polygon into y-monotone pieces
+// (de Berg et al., chapter 3): the status holds the edges with the polygon
+// on their right, each with its helper, the lowest vertex seen so far that
+// a diagonal from below could reach. Every piece is then triangulated in
+// linear time by going down its two chains at once.
+//
+// Outer rings must be counterclockwise and holes clockwise, as
+// boolean_operation returns them, and the rings simple and disjoint.
+
+namespace triangulation
+{
+enum class VertexType : unsigned char
+{
+    start,
+    end,
+    split,
+    merge,
+    regular,
+};
+
+// Triangulate a y-monotone piece given counterclockwise by vertex index,
+// appending counterclockwise triangles. The two chains are merged from
+// the top, then the vertices not yet triangulated wait on a stack.
+template <class Kernel>
+void triangulate_monotone(const std::vector<typename Kernel::Point> &points, const std::vector<uint32_t> &piece,
+                          std::vector<uint32_t> &triangles)
+{
+    auto m = piece.size();
+    if (m < 3)
+    {
+        return;
+    }
+    auto above = [&points](uint32_t i, uint32_t j) {
+        return vertically_less(points[j], points[i]);
+    };
+    auto turns_left = [&points](uint32_t a, uint32_t b, uint32_t c) {
+        return Kernel::orientation(points[a], points[b], Kernel::to_event_point(points[c])) > 0;
+    };
+
+    size_t top = 0, bottom = 0;
+    for (size_t i = 1; i < m; ++i)
+    {
+        top = above(piece[i], piece[top]) ? i : top;
+        bottom = above(piece[bottom], piece[i]) ? i : bottom;
+    }
+    // (vertex, on the left chain), counterclockwise from the top goes down
+    // the left chain
+    auto sorted = std::vector<std::pair<uint32_t, bool>>();
+    sorted.reserve(m);
+    sorted.push_back({piece[top], true});
+    for (auto i = (top + 1) % m, j = (top + m - 1) % m; i != bottom || j != bottom;)
+    {
+        if (j == bottom || (i != bottom && above(piece[i], piece[j])))
+        {
+            sorted.push_back({piece[i], true});
+            i = (i + 1) % m;
+        }
+        else
+        {
+            sorted.push_back({piece[j], false});
+            j = (j + m - 1) % m;
+        }
+    }
+    sorted.push_back({piece[bottom], true});
+
+    auto stack = std::vector<uint32_t>{sorted[0].first, sorted[1].first};
+    bool stack_left = sorted[1].second;
+    // fan from v to all of the stack, on the other chain
+    auto fan = [&](uint32_t v, bool left) {
+        for (size_t k = 0; k + 1 < stack.size(); ++k)
+        {
+            auto upper = stack[k], lower = stack[k + 1];
+            triangles.insert(triangles.end(), {v, left ? lower : upper, left ? upper : lower});
+        }
+    };
+    for (size_t j = 2; j + 1 < m; ++j)
+    {
+        auto v = sorted[j].first;
+        bool left = sorted[j].second;
+        if (left != stack_left)
+        {
+            fan(v, left);
+            auto previous = stack.back();
+            stack = {previous, v};
+        }
+        else
+        {
+            auto last = stack.back();
+            stack.pop_back();
+            while (!stack.empty() && (left ? turns_left(stack.back(), last, v) : turns_left(v, last, stack.back())))
+            {
+                auto upper = stack.back();
+                triangles.insert(triangles.end(), {left ? upper : v, last, left ? v : upper});
+                last = upper;
+                stack.pop_back();
+            }
+            stack.push_back(last);
+            stack.push_back(v);
+        }
+        stack_left = left;
+    }
+    fan(sorted[m - 1].first, !stack_left);
+}
+} // namespace triangulation
+
+// Triangles of the polygon as a flat index buffer, three indices per
+// triangle into the vertices of the rings numbered one ring after the
+// other, in O(n log n).
+template <class Kernel>
+std::vector<uint32_t> triangulate(const std::vector<Ring<Kernel>> &rings)
+{
+    using Point = typename Kernel::Point;
+    using triangulation::VertexType;
+
+    auto points = std::vector<Point>();
+    auto prev = std::vector<uint32_t>(), next = std::vector<uint32_t>();
+    for (const auto &ring : rings)
+    {
+        uint32_t first = points.size(), m = ring.size();
+        for (uint32_t k = 0; k < m; ++k)
+        {
+            points.push_back(ring[k]);
+            prev.push_back(first + (k + m - 1) % m);
+            next.push_back(first + (k + 1) % m);
+        }
+    }
+    auto n = points.size();
+
+    auto above = [&points](uint32_t i, uint32_t j) {
+        return vertically_less(points[j], points[i]);
+    };
+    auto types = std::vector<VertexType>(n);
+    for (uint32_t v = 0; v < n; ++v)
+    {
+        auto u = prev[v], w = next[v];
+        bool convex = Kernel::orientation(points[u], points[v], Kernel::to_event_point(points[w])) > 0;
+        if (above(v, u) && above(v, w))
+        {
+            types[v] = convex ? VertexType::start : VertexType::split;
+        }
+        else if (above(u, v) && above(w, v))
+        {
+            types[v] = convex ? VertexType::end : VertexType::merge;
+        }
+        else
+        {
+            types[v] = VertexType::regular;
+        }
+    }
+
+    auto order = std::vector<uint32_t>(n);
+    for (uint32_t v = 0; v < n; ++v)
+    {
+        order[v] = v;
+    }
+    std::sort(order.begin(), order.end(), above);
+
+    // edge i runs from vertex i to next[i], it is in the status with the
+    // polygon on its right
+    auto status = Status<Kernel>();
+    auto helper = std::vector<uint32_t>(n);
+    auto diagonals = std::vector<std::pair<uint32_t, uint32_t>>();
+    diagonals.reserve(n / 2);
+
+    auto insert = [&](uint32_t i) {
+        auto edge = Segment<Kernel>{points[i], points[next[i]]};
+        edge.key = Kernel::to_event_point(points[i]);
+        edge.id = i;
+        status.insert(edge);
+        helper[i] = i;
+    };
+    auto erase = [&](uint32_t i, uint32_t v) {
+        auto through = segments_through(status, Kernel::to_event_point(points[v]));
+        for (auto it = through.first; it != through.second; ++it)
+        {
+            if (it->id == i)
+            {
+                status.erase(it);
+                return;
+            }
+        }
+        assert(false && "edge not in the status!");
+    };
+    // the edge directly left of v
+    auto left_of = [&](uint32_t v) {
+        auto it = segments_through(status, Kernel::to_event_point(points[v])).first;
+        assert(it != status.begin() && "no edge left of the vertex!");
+        return uint32_t(std::prev(it)->id);
+    };
+    // a merge vertex waits for the next vertex below to connect to
+    auto connect_merge = [&](uint32_t v, uint32_t i) {
+        if (types[helper[i]] == VertexType::merge)
+        {
+            diagonals.push_back({v, helper[i]});
+        }
+    };
+
+    for (auto v : order)
+    {
+        switch (types[v])
+        {
+        case VertexType::start:
+            insert(v);
+            break;
+        case VertexType::end:
+            connect_merge(v, prev[v]);
+            erase(prev[v], v);
+            break;
+        case VertexType::split:
+        {
+            auto j = left_of(v);
+            diagonals.push_back({v, helper[j]});
+            helper[j] = v;
+            insert(v);
+            break;
+        }
+        case VertexType::merge:
+        {
+            connect_merge(v, prev[v]);
+            erase(prev[v], v);
+            auto j = left_of(v);
+            connect_merge(v, j);
+            helper[j] = v;
+            break;
+        }
+        case VertexType::regular:
+            if (above(prev[v], v))
+            {
+                // going down, the polygon is on the right
+                connect_merge(v, prev[v]);
+                erase(prev[v], v);
+                insert(v);
+            }
+            else
+            {
+                auto j = left_of(v);
+                connect_merge(v, j);
+                helper[j] = v;
+            }
+            break;
+        }
+    }
+
+    // the monotone pieces are the faces of the edges and diagonals inside
+    auto segments = std::vector<Segment<Kernel>>();
+    segments.reserve(n + diagonals.size());
+    auto dcel = Dcel<Kernel>();
+    dcel.half_edges.reserve(2 * (n + diagonals.size()));
+    for (uint32_t v = 0; v < n; ++v)
+    {
+        dcel.add_vertex(Kernel::to_event_point(points[v]));
+    }
+    auto add = [&](uint32_t from, uint32_t to) {
+        auto h = dcel.add_edge(from, segments.size(), true);
+        dcel.half_edges[h + 1].origin = to;
+        segments.push_back({points[from], points[to]});
+    };
+    for (uint32_t v = 0; v < n; ++v)
+    {
+        add(v, next[v]);
+    }
+    for (const auto &diagonal : diagonals)
+    {
+        add(diagonal.first, diagonal.second);
+    }
+
+    // half-edges by origin
+    auto first = std::vector<size_t>(n + 1, 0);
+    for (const auto &h : dcel.half_edges)
+    {
+        ++first[h.origin + 1];
+    }
+    for (size_t v = 0; v < n; ++v)
+    {
+        first[v + 1] += first[v];
+    }
+    auto by_origin = std::vector<size_t>(dcel.half_edges.size());
+    auto fill = first;
+    for (size_t h = 0; h < dcel.half_edges.size(); ++h)
+    {
+        by_origin[fill[dcel.half_edges[h].origin]++] = h;
+    }
+    auto outgoing = std::vector<size_t>();
+    for (size_t v = 0; v < n; ++v)
+    {
+        outgoing.assign(by_origin.begin() + first[v], by_origin.begin() + first[v + 1]);
+        dcel.link_around(v, outgoing, segments);
+    }
+
+    // the twins of the ring edges are outside
+    auto triangles = std::vector<uint32_t>();
+    triangles.reserve(3 * (n + 2 * rings.size()));
+    auto visited = std::vector<bool>(dcel.half_edges.size(), false);
+    auto piece = std::vector<uint32_t>();
+    for (size_t h = 0; h < dcel.half_edges.size(); ++h)
+    {
+        if (visited[h] || (h < 2 * n && h % 2 == 1))
+        {
+            continue;
+        }
+        piece.clear();
+        for (auto e = h; !visited[e]; e = dcel.half_edges[e].next)
+        {
+            visited[e] = true;
+            piece.push_back(dcel.half_edges[e].origin);
+        }
+        triangulation::triangulate_monotone<Kernel>(points, piece, triangles);
+    }
+    return triangles;
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef VALIDATION_HPP
+#define VALIDATION_HPP
+
+#include <vector>
+
+#include "sweep_line.hpp"
+#include "parallel.hpp"
+
+// A ring is simple when its edges only meet at the vertices shared by
+// consecutive edges: at every event point exactly one edge arrives and the
+// next one leaves, without turning back along it, and no other edge
+// touches the point. Zero length edges (repeated vertices) are ignored.
+// The sweep stops at the first point that breaks this.
+template <class Kernel>
+bool is_simple(const Ring<Kernel> &ring)
+{
+    auto segments = std::vector<Segment<Kernel>>();
+    segments.reserve(ring.size());
+    for (size_t i = 0; i < ring.size(); ++i)
+    {
+        segments.push_back({ring[i], ring[(i + 1) % ring.size()]});
+    }
+
+    bool simple = !ring.empty();
+    sweep_line(segments, [&](const auto &point, const auto &events, const auto &status) {
+        size_t arriving = 0, leaving = 0;
+        size_t from = 0, to = 0;
+        // false if the edge touches the point other than at its ends
+        auto visit = [&](size_t id) {
+            const auto &edge = segments[id];
+            if (edge.a == edge.b)
+            {
+                return true;
+            }
+            if (Kernel::equal(point, Kernel::to_event_point(edge.b)))
+            {
+                ++arriving;
+                from = id;
+                return true;
+            }
+            if (Kernel::equal(point, Kernel::to_event_point(edge.a)))
+            {
+                ++leaving;
+                to = id;
+                return true;
+            }
+            return false;
+        };
+
+        // the edges ending here have left the sweep line, the others are on it
+        for (const auto &event : events)
+        {
+            if (event.type == Event<Kernel>::Type::lower && !visit(event.segment.id))
+            {
+                return simple = false;
+            }
+        }
+        auto through = segments_through(status, point);
+        for (auto it = through.first; it != through.second; ++it)
+        {
+            if (!visit(it->id))
+            {
+                return simple = false;
+            }
+        }
+        if (arriving != 1 || leaving != 1)
+        {
+            return simple = false;
+        }
+
+        // a spike: the next edge goes back along the previous one
+        const auto &in = segments[from], &out = segments[to];
+        if (Kernel::orientation(in.a, in.b, out.b) == 0 &&
+            vertically_less(in.a, in.b) == vertically_less(out.b, out.a))
+        {
+            return simple = false;
+        }
+        return true;
+    });
+    return simple;
+}
+
+// simple[i] tells whether rings[i] is simple, rings are checked in parallel
+template <class Kernel>
+std::vector<char> validate_rings(const std::vector<Ring<Kernel>> &rings)
+{
+    auto simple = std::vector<char>(rings.size());
+    parallel_for(rings.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+        {
+            simple[i] = is_simple<Kernel>(rings[i]);
+        }
+    }, 16);
+    return simple;
+}
+
+#endif
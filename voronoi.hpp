@@ -0,0 +1,417 @@
+#ifndef VORONOI_HPP
+#define VORONOI_HPP
+
+#include <queue>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <algorithm>
+
+#include "kernel.hpp"
+
+// Voronoi diagram of point sites by Fortune's sweep, top to bottom like the
+// segment sweep. The status is the beach line, the lower envelope of the
+// parabolas of the sites above the sweep line, one arc per piece. Site
+// events split the arc above them, circle events remove an arc squeezed to
+// a point, which is a Voronoi vertex. Whether three sites make a circle
+// event is the kernel's orientation; the vertices themselves are doubles.
+//
+// Unlike the other sweeps this is not an instance of sweep_line: the
+// EventQueue and Status of the framework are sets of segments under a
+// comparator fixed for the sweep, which cannot hold the breakpoints of a
+// beach line, moving with the sweep line, nor circle events that go stale.
+// The beach line is a treap of pooled arcs and the circle events a binary
+// heap, invalidated lazily.
+
+struct VoronoiDiagram
+{
+    static constexpr size_t none = size_t(-1);
+
+    // part of the bisector of two sites, by index; walking from `from` to
+    // `to`, site `left` is on the left. Unbounded ends are none.
+    struct Edge
+    {
+        size_t left, right;
+        size_t from, to;
+    };
+
+    std::vector<vector2<double>> vertices;
+    std::vector<Edge> edges;
+};
+
+namespace voronoi
+{
+// An arc of the beach line. Arcs live in a pool and are reused; they are
+// linked in beach line order and, for locating sites, kept in a treap.
+struct Arc
+{
+    size_t site;
+    size_t prev, next;
+    size_t parent, left, right;
+    uint32_t priority;
+    size_t event; // the pending circle event, none if there is none
+    size_t edge;  // traced by the breakpoint with the next arc
+};
+
+struct CircleEvent
+{
+    vector2<double> center;
+    double y; // bottom of the circle
+    size_t arc;
+    size_t id;
+
+    vector2<double> point() const
+    {
+        return {center.x, y};
+    }
+
+    bool operator<(const CircleEvent &other) const
+    {
+        return vertically_less(point(), other.point());
+    }
+};
+
+// x of the breakpoint with the arc of p on the left and the one of q on
+// the right when the sweep line is at height l
+inline double breakpoint(const vector2<double> &p, const vector2<double> &q, double l)
+{
+    auto dp = p.y - l, dq = q.y - l;
+    if (dp == 0 && dq == 0)
+    {
+        return (p.x + q.x) / 2;
+    }
+    if (dp == 0)
+    {
+        return p.x;
+    }
+    if (dq == 0)
+    {
+        return q.x;
+    }
+    // root of dq (x - p.x)^2 - dp (x - q.x)^2 + dp dq (p.y - q.y) where the
+    // parabola of q starts to be the lower one
+    auto a = dq - dp;
+    auto b = -2 * (dq * p.x - dp * q.x);
+    auto c = dq * p.x * p.x - dp * q.x * q.x + dp * dq * (p.y - q.y);
+    auto root = std::sqrt(std::max(0.0, b * b - 4 * a * c));
+    return b <= 0 ? (root - b) / (2 * a) : 2 * c / (-b - root);
+}
+
+class BeachLine
+{
+  public:
+    static constexpr size_t none = VoronoiDiagram::none;
+
+    std::vector<Arc> arcs;
+
+    size_t allocate(size_t site)
+    {
+        size_t arc;
+        if (free.empty())
+        {
+            arc = arcs.size();
+            arcs.emplace_back();
+        }
+        else
+        {
+            arc = free.back();
+            free.pop_back();
+        }
+        // xorshift
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        arcs[arc] = {site, none, none, none, none, none, seed, none, none};
+        return arc;
+    }
+
+    bool empty() const
+    {
+        return root == none;
+    }
+
+    // the arc above x, site_of gives the position of a site: the last one
+    // whose left breakpoint is not right of x
+    template <class SiteOf>
+    size_t locate(double x, double l, SiteOf &&site_of) const
+    {
+        auto found = none;
+        for (auto arc = root; arc != none;)
+        {
+            const auto &a = arcs[arc];
+            if (a.prev != none && x < breakpoint(site_of(arcs[a.prev].site), site_of(a.site), l))
+            {
+                arc = a.left;
+            }
+            else
+            {
+                found = arc;
+                arc = a.right;
+            }
+        }
+        return found;
+    }
+
+    // insert a new arc right after `after`, or first if after is none
+    void insert_after(size_t after, size_t arc)
+    {
+        auto next = after == none ? first() : arcs[after].next;
+        arcs[arc].prev = after;
+        arcs[arc].next = next;
+        if (after != none)
+        {
+            arcs[after].next = arc;
+        }
+        if (next != none)
+        {
+            arcs[next].prev = arc;
+        }
+
+        if (root == none)
+        {
+            root = arc;
+            return;
+        }
+        if (next != none && arcs[next].left == none)
+        {
+            link(next, arc, true);
+        }
+        else
+        {
+            // the slot right of `after` is free then
+            link(after, arc, false);
+        }
+        while (arcs[arc].parent != none && arcs[arcs[arc].parent].priority < arcs[arc].priority)
+        {
+            rotate_up(arc);
+        }
+    }
+
+    void erase(size_t arc)
+    {
+        for (;;)
+        {
+            auto l = arcs[arc].left, r = arcs[arc].right;
+            if (l == none && r == none)
+            {
+                break;
+            }
+            rotate_up(r == none || (l != none && arcs[l].priority > arcs[r].priority) ? l : r);
+        }
+        replace_child(arcs[arc].parent, arc, none);
+
+        auto prev = arcs[arc].prev, next = arcs[arc].next;
+        if (prev != none)
+        {
+            arcs[prev].next = next;
+        }
+        if (next != none)
+        {
+            arcs[next].prev = prev;
+        }
+        free.push_back(arc);
+    }
+
+  private:
+    size_t first() const
+    {
+        auto arc = root;
+        while (arc != none && arcs[arc].left != none)
+        {
+            arc = arcs[arc].left;
+        }
+        return arc;
+    }
+
+    void link(size_t parent, size_t child, bool left)
+    {
+        (left ? arcs[parent].left : arcs[parent].right) = child;
+        if (child != none)
+        {
+            arcs[child].parent = parent;
+        }
+    }
+
+    void replace_child(size_t parent, size_t child, size_t by)
+    {
+        if (parent == none)
+        {
+            root = by;
+        }
+        else
+        {
+            link(parent, by, arcs[parent].left == child);
+        }
+        if (by != none)
+        {
+            arcs[by].parent = parent;
+        }
+    }
+
+    void rotate_up(size_t arc)
+    {
+        auto parent = arcs[arc].parent;
+        auto grandparent = arcs[parent].parent;
+        if (arcs[parent].left == arc)
+        {
+            link(parent, arcs[arc].right, true);
+            link(arc, parent, false);
+        }
+        else
+        {
+            link(parent, arcs[arc].left, false);
+            link(arc, parent, true);
+        }
+        replace_child(grandparent, parent, arc);
+    }
+
+    size_t root = none;
+    std::vector<size_t> free;
+    uint32_t seed = 2463534242;
+};
+} // namespace voronoi
+
+// Voronoi diagram of the sites in O(n log n). Circle events are not
+// removed from the queue when their arc changes, they are only dropped once
+// they come up. Repeated sites are skipped.
+template <class Kernel>
+VoronoiDiagram voronoi_diagram(const std::vector<typename Kernel::Point> &sites)
+{
+    using voronoi::CircleEvent;
+    constexpr auto none = VoronoiDiagram::none;
+
+    // at most 2 n - 5 vertices and 3 n - 6 edges
+    auto diagram = VoronoiDiagram();
+    diagram.vertices.reserve(2 * sites.size());
+    diagram.edges.reserve(3 * sites.size());
+    auto beach = voronoi::BeachLine();
+    auto queue = std::vector<CircleEvent>();
+    queue.reserve(sites.size());
+    auto circles = std::priority_queue<CircleEvent>(std::less<CircleEvent>(), std::move(queue));
+    size_t num_circles = 0;
+
+    // sites from the top, equal y from the right, with their index. The
+    // sweep refers to them by position in this order, so that the sites
+    // near the sweep line are near each other in memory.
+    auto sorted = std::vector<std::pair<typename Kernel::Point, size_t>>(sites.size());
+    for (size_t i = 0; i < sites.size(); ++i)
+    {
+        sorted[i] = {sites[i], i};
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto &s1, const auto &s2) {
+        return vertically_less(s2.first, s1.first);
+    });
+
+    auto site_of = [&sorted](size_t site) {
+        return Kernel::to_double(sorted[site].first);
+    };
+    auto &arcs = beach.arcs;
+
+    // the breakpoint after the arc ends at vertex
+    auto finish = [&](size_t arc, size_t vertex) {
+        auto &edge = diagram.edges[arcs[arc].edge];
+        (edge.left == arcs[arcs[arc].next].site ? edge.to : edge.from) = vertex;
+    };
+    // a new edge traced by the breakpoint after the arc
+    auto trace = [&](size_t arc, size_t from) {
+        arcs[arc].edge = diagram.edges.size();
+        diagram.edges.push_back({arcs[arcs[arc].next].site, arcs[arc].site, from, none});
+    };
+    auto check = [&](size_t arc) {
+        arcs[arc].event = none;
+        auto prev = arcs[arc].prev, next = arcs[arc].next;
+        if (prev == none || next == none)
+        {
+            return;
+        }
+        const auto &a = sorted[arcs[prev].site].first, &b = sorted[arcs[arc].site].first;
+        const auto &c = sorted[arcs[next].site].first;
+        // the breakpoints only converge when the sites turn clockwise
+        if (arcs[prev].site == arcs[next].site || Kernel::orientation(a, b, Kernel::to_event_point(c)) >= 0)
+        {
+            return;
+        }
+        auto pb = site_of(arcs[arc].site);
+        auto pa = site_of(arcs[prev].site) - pb, pc = site_of(arcs[next].site) - pb;
+        auto d = 2 * (pa.x * pc.y - pa.y * pc.x);
+        auto na = pa.x * pa.x + pa.y * pa.y, nc = pc.x * pc.x + pc.y * pc.y;
+        auto u = vector2<double>((pc.y * na - pa.y * nc) / d, (pa.x * nc - pc.x * na) / d);
+        auto center = pb + u;
+        auto radius = std::sqrt(u.x * u.x + u.y * u.y);
+        arcs[arc].event = num_circles;
+        circles.push({center, center.y - radius, arc, num_circles++});
+    };
+
+    auto add_site = [&](size_t site) {
+        auto s = site_of(site);
+        if (beach.empty())
+        {
+            beach.insert_after(none, beach.allocate(site));
+            return;
+        }
+        auto arc = beach.locate(s.x, s.y, site_of);
+        if (site_of(arcs[arc].site).y == s.y)
+        {
+            // still on the first row of sites, the new one comes in on the left
+            auto added = beach.allocate(site);
+            beach.insert_after(none, added);
+            trace(added, none);
+            return;
+        }
+        // the arc is split in two around the new one, their breakpoints
+        // trace the same edge from both of its ends
+        auto added = beach.allocate(site), split = beach.allocate(arcs[arc].site);
+        beach.insert_after(arc, added);
+        beach.insert_after(added, split);
+        arcs[split].edge = arcs[arc].edge;
+        trace(arc, none);
+        arcs[added].edge = arcs[arc].edge;
+        check(arc);
+        check(split);
+    };
+
+    auto remove_arc = [&](const CircleEvent &event) {
+        auto arc = event.arc;
+        auto prev = arcs[arc].prev, next = arcs[arc].next;
+        auto vertex = diagram.vertices.size();
+        diagram.vertices.push_back(event.center);
+        finish(prev, vertex);
+        finish(arc, vertex);
+        beach.erase(arc);
+        trace(prev, vertex);
+        check(prev);
+        check(next);
+    };
+
+    for (size_t i = 0; i < sorted.size() || !circles.empty();)
+    {
+        if (!circles.empty() && arcs[circles.top().arc].event != circles.top().id)
+        {
+            circles.pop();
+            continue;
+        }
+        if (i < sorted.size() && (circles.empty() || vertically_less(circles.top().point(), site_of(i))))
+        {
+            if (i == 0 || !(sorted[i - 1].first == sorted[i].first))
+            {
+                add_site(i);
+            }
+            ++i;
+            continue;
+        }
+        auto event = circles.top();
+        circles.pop();
+        remove_arc(event);
+    }
+
+    for (auto &edge : diagram.edges)
+    {
+        edge.left = sorted[edge.left].second;
+        edge.right = sorted[edge.right].second;
+    }
+    return diagram;
+}
+
+#endif